@@ -0,0 +1,143 @@
+#include "Benchmark.h"
+#include "IntersectKernels.h"
+#include <fstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+volatile float benchSink = 0;
+
+
+size_t getPeakMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;			// bytes
+#else
+	return (size_t)usage.ru_maxrss * 1024;	// kilobytes
+#endif
+#endif
+}
+
+
+// the machine the results are from
+static void writeJsonHeader(std::ofstream& out) {
+	out << "{\n";
+	out << "  \"cores\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "  \"simd\": " << (hasSimdKernels() ? "true" : "false") << ",\n";
+}
+
+bool writeBenchJson(const string& path, const vector<BenchResult>& results) {
+	std::ofstream out(path);
+	if (!out) {
+		ofLogError("Benchmark") << "can't write " << path;
+		return false;
+	}
+
+	writeJsonHeader(out);
+	out << "  \"benchmarks\": [\n";
+	for (int i = 0; i < results.size(); i++) {
+		const BenchResult& r = results[i];
+		double perSecond = (r.nsPerOp > 0) ? 1e9 / r.nsPerOp : 0;
+		out << "    { \"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", "
+			<< "\"ops\": " << r.ops << ", \"ns_per_op\": " << r.nsPerOp << ", "
+			<< ((r.unit == "ray") ? "\"rays_per_s\": " : "\"ops_per_s\": ") << perSecond << " }"
+			<< ((i + 1 < results.size()) ? ",\n" : "\n");
+	}
+	out << "  ]\n";
+	out << "}\n";
+	return bool(out);
+}
+
+bool writeSceneJson(const string& path, const vector<SceneResult>& results) {
+	std::ofstream out(path);
+	if (!out) {
+		ofLogError("Benchmark") << "can't write " << path;
+		return false;
+	}
+
+	writeJsonHeader(out);
+	out << "  \"scenes\": [\n";
+	for (int i = 0; i < results.size(); i++) {
+		const SceneResult& r = results[i];
+		out << "    { \"name\": \"" << r.name << "\", \"scene\": \"" << r.scene << "\", "
+			<< "\"threads\": " << r.threads << ", \"objects\": " << r.objects << ", \"lights\": " << r.lights << ", "
+			<< "\"width\": " << r.width << ", \"height\": " << r.height << ", \"passes\": " << r.passes << ", "
+			<< "\"ms\": " << r.ms << ", \"rays_per_s\": " << r.raysPerSecond << ", "
+			<< "\"speedup\": " << r.speedup << ", \"peak_memory_mb\": " << r.peakMemoryMB << " }"
+			<< ((i + 1 < results.size()) ? ",\n" : "\n");
+	}
+	out << "  ]\n";
+	out << "}\n";
+	return bool(out);
+}
+
+
+vector<BenchMetric> getMetrics(const vector<BenchResult>& results) {
+	vector<BenchMetric> metrics;
+	for (auto& r : results) metrics.push_back({ r.name, r.nsPerOp });
+	return metrics;
+}
+
+vector<BenchMetric> getMetrics(const vector<SceneResult>& results) {
+	vector<BenchMetric> metrics;
+	for (auto& r : results) metrics.push_back({ r.name, r.ms });
+	return metrics;
+}
+
+// the writers above put every result on a line of its own, so a baseline is read
+// line by line: the name and the ns_per_op (kernels) or ms (scenes) of each
+bool readBaseline(const string& path, vector<BenchMetric>& metrics) {
+	std::ifstream file(path);
+	if (!file) {
+		ofLogError("Benchmark") << "can't open baseline " << path;
+		return false;
+	}
+
+	metrics.clear();
+	string line;
+	while (std::getline(file, line)) {
+		size_t name = line.find("\"name\": \"");
+		if (name == string::npos) continue;
+		name += 9;
+		size_t nameEnd = line.find('"', name);
+
+		size_t value = line.find("\"ns_per_op\": ");
+		if (value != string::npos) value += 13;
+		else if ((value = line.find("\"ms\": ")) != string::npos) value += 6;
+		if (nameEnd == string::npos || value == string::npos) continue;
+
+		metrics.push_back({ line.substr(name, nameEnd - name), atof(line.c_str() + value) });
+	}
+	return true;
+}
+
+int compareToBaseline(const vector<BenchMetric>& current, const vector<BenchMetric>& baseline, double tolerance) {
+	int regressions = 0;
+	printf("\n%-48s %12s %12s %8s\n", "compared to baseline", "baseline", "current", "change");
+	for (auto& metric : current) {
+		for (auto& base : baseline) {
+			if (base.name != metric.name || base.value <= 0) continue;
+
+			double change = metric.value / base.value - 1;
+			bool bRegression = change > tolerance;
+			printf("%-48s %12.2f %12.2f %+7.1f%%%s\n", metric.name.c_str(), base.value, metric.value,
+				change * 100, bRegression ? "  SLOWER" : "");
+			if (bRegression) regressions++;
+			break;
+		}
+	}
+	return regressions;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Renderer.h"
+#include <chrono>
+
+
+//  Timing harness for the benchmarks: every kernel is called over and over on
+//  inputs prepared up front, and the fastest of a few runs is reported.
+
+struct BenchResult {
+	string name;
+	string unit;			// what one op is: "ray", "sample", "lookup", "point"
+	double nsPerOp = 0;
+	long long ops = 0;		// ops in the best run
+};
+
+// full frame render of one scene with some number of threads
+struct SceneResult {
+	string name;			// scene and thread count, e.g. "spheres-1000 t4"
+	string scene;
+	int threads = 0;
+	int objects = 0, lights = 0;
+	int width = 0, height = 0, passes = 1;
+	double ms = 0;			// wall time of the fastest run
+	double raysPerSecond = 0;	// primary rays
+	double speedup = 0;		// over the same scene with 1 thread, 0 if that wasn't run
+	double peakMemoryMB = 0;	// of the whole process so far, scenes run smallest first
+};
+
+struct BenchOptions {
+	double minTime = 0.2;	// seconds per run
+	int runs = 5;			// the fastest run is reported
+	string filter;			// only run benchmarks whose name contains this
+
+	// scene corpus
+	int sceneRuns = 3;
+	vector<int> threads;	// thread counts to render every scene with, empty: 1, 2, 4, .. all cores
+	int width = 400, height = 300, passes = 1;
+	int maxSpheres = 1000000;	// largest generated scene
+	int maxLights = 1000;
+	string corpus = "bin/data/scenes";	// default.scene and room.scene
+};
+
+// a timed value where lower is better: ns/op of a kernel or ms of a scene
+struct BenchMetric {
+	string name;
+	double value;
+};
+
+// results feed into this so the compiler can't drop the work being timed
+extern volatile float benchSink;
+
+// seconds since an arbitrary start
+inline double benchTime() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// time fn(), which does opsPerCall ops of the given unit per call.  Returns
+// false (and times nothing) if the name doesn't match the filter.
+template<class F>
+bool timeKernel(const BenchOptions& options, const string& name, const string& unit,
+	int opsPerCall, F fn, vector<BenchResult>& results) {
+	if (!options.filter.empty() && name.find(options.filter) == string::npos) return false;
+
+	// find a call count that takes about minTime
+	long long calls = 1;
+	for (;;) {
+		double start = benchTime();
+		for (long long i = 0; i < calls; i++) fn();
+		double elapsed = benchTime() - start;
+		if (elapsed >= options.minTime || calls >= (1LL << 40)) break;
+		calls *= (elapsed < options.minTime / 16) ? 16 : 2;
+	}
+
+	BenchResult result;
+	result.name = name;
+	result.unit = unit;
+	result.ops = calls * opsPerCall;
+	double best = 1e30;
+	for (int run = 0; run < options.runs; run++) {
+		double start = benchTime();
+		for (long long i = 0; i < calls; i++) fn();
+		best = std::min(best, benchTime() - start);
+	}
+	result.nsPerOp = best * 1e9 / result.ops;
+	results.push_back(result);
+
+	printf("%-48s %12.2f ns/%s\n", name.c_str(), result.nsPerOp, unit.c_str());
+	return true;
+}
+
+// all microbenchmarks of the renderer's kernels (Microbenchmarks.cpp)
+void runMicrobenchmarks(const BenchOptions& options, vector<BenchResult>& results);
+
+// render every scene of the corpus (SceneBenchmarks.cpp)
+void runSceneBenchmarks(const BenchOptions& options, vector<SceneResult>& results);
+
+// the app's default floor and lights, shared by the benchmark scenes
+RenderObject makeBenchFloor();
+void addDefaultLights(RenderScene& scene);
+
+// peak resident memory of the process in bytes, 0 if unknown
+size_t getPeakMemory();
+
+// write results as json: ns/op plus rays/s for ray kernels, ops/s for the others
+bool writeBenchJson(const string& path, const vector<BenchResult>& results);
+bool writeSceneJson(const string& path, const vector<SceneResult>& results);
+
+// regression gate.  Baselines are json files written by an earlier run
+// (-save-baseline), their metrics are read back by name.
+vector<BenchMetric> getMetrics(const vector<BenchResult>& results);
+vector<BenchMetric> getMetrics(const vector<SceneResult>& results);
+bool readBaseline(const string& path, vector<BenchMetric>& metrics);
+// print how every metric compares to its baseline, returns how many are slower
+// by more than tolerance (0.1 = 10%).  Metrics missing on either side are skipped.
+int compareToBaseline(const vector<BenchMetric>& current, const vector<BenchMetric>& baseline, double tolerance);
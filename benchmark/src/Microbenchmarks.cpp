@@ -0,0 +1,350 @@
+#include "Benchmark.h"
+#include "Primitives.h"
+
+
+// every kernel cycles through this many prepared inputs per call
+static const int numInputs = 1024;
+
+static glm::vec3 randomIn(std::mt19937& rng, const glm::vec3& center, const glm::vec3& halfSize) {
+	std::uniform_real_distribution<float> r(-1, 1);
+	return center + halfSize * glm::vec3(r(rng), r(rng), r(rng));
+}
+
+// rays from random points around from towards random points around to
+static vector<Ray> makeRays(std::mt19937& rng, const glm::vec3& from, const glm::vec3& fromSize,
+	const glm::vec3& to, const glm::vec3& toSize) {
+	vector<Ray> rays(numInputs);
+	for (auto& ray : rays) {
+		glm::vec3 o = randomIn(rng, from, fromSize);
+		ray = Ray(o, glm::normalize(randomIn(rng, to, toSize) - o));
+	}
+	return rays;
+}
+
+// floor plane of the app's default scene
+RenderObject makeBenchFloor() {
+	RenderObject floor;
+	floor.type = RenderObject::Plane;
+	floor.position = glm::vec3(0, -2, 0);
+	floor.normal = glm::vec3(0, 1, 0);
+	floor.upDir = Plane::getUpDir(floor.normal);
+	floor.width = floor.height = 20;
+	floor.diffuseColor = ofColor::darkGray;
+	Plane::getExtent(floor.position, floor.normal, floor.width, floor.height, floor.extent);
+	return floor;
+}
+
+// two point lights and a 10 x 10 area light (102 light samples)
+void addDefaultLights(RenderScene& scene) {
+	RenderLight light;
+	light.position = glm::vec3(5, 8, 0);
+	light.intensity = 200;
+	scene.lights.push_back(light);
+	light.position = glm::vec3(-3, 10, 0);
+	light.intensity = 100;
+	scene.lights.push_back(light);
+	light.type = RenderLight::Area;
+	light.position = glm::vec3(0, 10, 0);
+	light.intensity = 10;
+	light.width = light.height = 5;
+	light.nDivsWidth = light.nDivsHeight = 10;
+	scene.lights.push_back(light);
+}
+
+
+static void intersectionBenchmarks(const BenchOptions& options, vector<BenchResult>& results) {
+	std::mt19937 rng(1);
+
+	// scene objects as the app tests them, about half of the rays hit
+	Sphere sphere(glm::vec3(0, 0, -5), 1.5);
+	vector<Ray> sphereRays = makeRays(rng, glm::vec3(0, 0, 5), glm::vec3(0.5), glm::vec3(0, 0, -5), glm::vec3(2.5, 2.5, 0));
+	timeKernel(options, "Sphere::intersect", "ray", numInputs, [&]() {
+		glm::vec3 point, normal;
+		int hits = 0;
+		for (auto& ray : sphereRays) hits += sphere.intersect(ray, point, normal);
+		benchSink = hits;
+	}, results);
+
+	Plane plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0));
+	vector<Ray> floorRays = makeRays(rng, glm::vec3(0, 5, 0), glm::vec3(1), glm::vec3(0, -2, 0), glm::vec3(15, 0, 15));
+	timeKernel(options, "Plane::intersect", "ray", numInputs, [&]() {
+		glm::vec3 point, normal;
+		int hits = 0;
+		for (auto& ray : floorRays) hits += plane.intersect(ray, point, normal);
+		benchSink = hits;
+	}, results);
+
+	// the renderer's kernels against one bvh leaf worth of spheres, and against a whole bvh
+	SphereArrays spheres;
+	spheres.resize(64);
+	std::uniform_real_distribution<float> radius(0.3, 0.8);
+	for (int i = 0; i < spheres.count; i++) {
+		glm::vec3 c = randomIn(rng, glm::vec3(0, 0, -7), glm::vec3(4, 4, 3));
+		spheres.cx[i] = c.x;
+		spheres.cy[i] = c.y;
+		spheres.cz[i] = c.z;
+		spheres.radius[i] = radius(rng);
+	}
+	timeKernel(options, "intersectSpheres 64 (scalar)", "ray", numInputs, [&]() {
+		int hits = 0;
+		for (auto& ray : sphereRays) {
+			float tMax = 1e30f;
+			int index;
+			hits += intersectSpheresScalar(spheres, 0, spheres.count, ray.p, ray.d, tMax, index);
+		}
+		benchSink = hits;
+	}, results);
+	if (hasSimdKernels()) {
+		timeKernel(options, "intersectSpheres 64 (simd)", "ray", numInputs, [&]() {
+			int hits = 0;
+			for (auto& ray : sphereRays) {
+				float tMax = 1e30f;
+				int index;
+				hits += intersectSpheres(spheres, 0, spheres.count, ray.p, ray.d, tMax, index);
+			}
+			benchSink = hits;
+		}, results);
+	}
+
+	SceneGeometry geometry;
+	for (int i = 0; i < 10000; i++) {
+		geometry.addSphere(randomIn(rng, glm::vec3(0, 0, -22), glm::vec3(20, 20, 17)), radius(rng) * 0.6f, i);
+	}
+	geometry.build();
+	vector<Ray> fieldRays = makeRays(rng, glm::vec3(0, 0, 5), glm::vec3(0.5), glm::vec3(0, 0, -40), glm::vec3(20, 20, 0));
+	timeKernel(options, "SceneGeometry::intersect 10k spheres", "ray", numInputs, [&]() {
+		GeometryHit hit;
+		int hits = 0;
+		for (auto& ray : fieldRays) hits += geometry.intersect(ray.p, ray.d, hit);
+		benchSink = hits;
+	}, results);
+	timeKernel(options, "SceneGeometry::occluded 10k spheres", "ray", numInputs, [&]() {
+		int hits = 0;
+		for (auto& ray : fieldRays) hits += geometry.occluded(ray.p, ray.d, 0, 30);
+		benchSink = hits;
+	}, results);
+
+	// coherent 8x8 packets of primary rays, like packet tracing shoots them
+	RenderView view = RenderView::lookAt(glm::vec3(0, 0, 5), glm::vec3(0, 0, -20), glm::vec3(0, 1, 0), 60, 1);
+	vector<RayPacket> packets(numInputs / RayPacket::maxRays);
+	std::uniform_int_distribution<int> block(0, 63);
+	for (auto& packet : packets) {
+		int bx = block(rng) * 8, by = block(rng) * 8;
+		for (int j = 0; j < 8; j++) {
+			for (int i = 0; i < 8; i++) {
+				glm::vec3 p = view.corner + ((bx + i + 0.5f) / 512) * view.right + ((by + j + 0.5f) / 512) * view.down;
+				packet.set(packet.count++, view.origin, glm::normalize(p - view.origin));
+			}
+		}
+	}
+	timeKernel(options, "SceneGeometry::intersectPacket 10k spheres", "ray", numInputs, [&]() {
+		GeometryHit hits[RayPacket::maxRays];
+		bool bHit[RayPacket::maxRays];
+		int count = 0;
+		for (auto& packet : packets) {
+			geometry.intersectPacket(packet, hits, bHit);
+			count += bHit[0];
+		}
+		benchSink = count;
+	}, results);
+}
+
+
+static void lightBenchmarks(const BenchOptions& options, vector<BenchResult>& results) {
+	std::mt19937 rng(2);
+	vector<glm::vec3> points(numInputs);
+	for (auto& p : points) p = randomIn(rng, glm::vec3(0, -2, 0), glm::vec3(10, 0, 10));
+	glm::vec3 up(0, 1, 0);
+	Sampler sampler;
+	sampler.setup(Sampler::Sobol, 0);
+
+	RenderLight point;
+	point.position = glm::vec3(5, 8, 0);
+	point.intensity = 200;
+	LightSample sample;
+	timeKernel(options, "RenderLight::getRaySamples point", "sample", numInputs, [&]() {
+		float sum = 0;
+		for (auto& p : points) {
+			point.getRaySamples(p, up, &sample, sampler, 1);
+			sum += sample.ray.d.x;
+		}
+		benchSink = sum;
+	}, results);
+
+	// the default scene's 10 x 10 area light, one sample per cell
+	RenderLight area;
+	area.type = RenderLight::Area;
+	area.position = glm::vec3(0, 10, 0);
+	area.intensity = 10;
+	area.width = area.height = 5;
+	area.nDivsWidth = area.nDivsHeight = 10;
+	area.compile();
+	vector<LightSample> samples(area.maxSamples());
+	const int areaPoints = 16;
+	timeKernel(options, "RenderLight::getRaySamples area 10x10", "sample", areaPoints * area.maxSamples(), [&]() {
+		float sum = 0;
+		for (int i = 0; i < areaPoints; i++) {
+			area.getRaySamples(points[i], up, samples.data(), sampler, 1);
+			sum += samples[0].ray.d.x;
+		}
+		benchSink = sum;
+	}, results);
+
+	// one pixel's worth of light samples in each pattern
+	for (int t = 0; t < Sampler::NumTypes; t++) {
+		sampler.setup((Sampler::Type)t, 0);
+		timeKernel(options, string("Sampler::get2D ") + Sampler::getTypeName((Sampler::Type)t), "sample", numInputs, [&]() {
+			float sum = 0;
+			sampler.startPixel(3, 5);
+			for (int i = 0; i < numInputs; i++) sum += sampler.get2D(i, 1).x;
+			benchSink = sum;
+		}, results);
+	}
+}
+
+
+static void textureBenchmarks(const BenchOptions& options, vector<BenchResult>& results) {
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> unit(0, 1);
+
+	// hit points on a sphere and on the floor, for both the scene objects and their render copies
+	Sphere sphere(glm::vec3(0, 1, -2), 2);
+	sphere.numTiles = 2;
+	RenderObject renderSphere;
+	renderSphere.position = sphere.position;
+	renderSphere.radius = sphere.radius;
+	renderSphere.numTiles = sphere.numTiles;
+	renderSphere.compile();
+	vector<glm::vec3> spherePoints(numInputs);
+	for (auto& p : spherePoints) {
+		glm::vec3 dir = randomIn(rng, glm::vec3(0), glm::vec3(1));
+		p = sphere.position + sphere.radius * glm::normalize(dir + glm::vec3(0, 0, 0.01f));
+	}
+
+	Plane plane(glm::vec3(0, -2, 0), glm::vec3(0, 1, 0));
+	RenderObject floor = makeBenchFloor();
+	floor.compile();
+	vector<glm::vec3> floorPoints(numInputs);
+	for (auto& p : floorPoints) p = randomIn(rng, glm::vec3(0, -2, 0), glm::vec3(10, 0, 10));
+
+	timeKernel(options, "Sphere::getTextureCoords", "point", numInputs, [&]() {
+		float sum = 0, u, v;
+		for (auto& p : spherePoints) {
+			sphere.getTextureCoords(p, u, v);
+			sum += u + v;
+		}
+		benchSink = sum;
+	}, results);
+	timeKernel(options, "Plane::getTextureCoords", "point", numInputs, [&]() {
+		float sum = 0, u, v;
+		for (auto& p : floorPoints) {
+			plane.getTextureCoords(p, u, v);
+			sum += u + v;
+		}
+		benchSink = sum;
+	}, results);
+	timeKernel(options, "RenderObject::getTextureCoords sphere", "point", numInputs, [&]() {
+		float sum = 0, u, v;
+		for (auto& p : spherePoints) {
+			renderSphere.getTextureCoords(p, u, v);
+			sum += u + v;
+		}
+		benchSink = sum;
+	}, results);
+	timeKernel(options, "RenderObject::getTextureCoords plane", "point", numInputs, [&]() {
+		float sum = 0, u, v;
+		for (auto& p : floorPoints) {
+			floor.getTextureCoords(p, u, v);
+			sum += u + v;
+		}
+		benchSink = sum;
+	}, results);
+
+	// noise maps the size of the app's texture sets, at random coordinates
+	ofPixels diffuse, specular;
+	diffuse.allocate(1024, 1024, OF_PIXELS_RGB);
+	specular.allocate(1024, 1024, OF_PIXELS_RGB);
+	for (size_t i = 0; i < diffuse.size(); i++) {
+		diffuse[i] = rng() & 0xff;
+		specular[i] = rng() & 0xff;
+	}
+	vector<glm::vec2> coords(numInputs);
+	for (auto& c : coords) c = glm::vec2(unit(rng), unit(rng));
+
+	timeKernel(options, "ofPixels::getColor lookup (diffuse + specular)", "lookup", numInputs, [&]() {
+		float sum = 0;
+		for (auto& c : coords) {
+			sum += diffuse.getColor(c.x * 1023, c.y * 1023).r + specular.getColor(c.x * 1023, c.y * 1023).getBrightness();
+		}
+		benchSink = sum;
+	}, results);
+
+	// magnified lookups are bilinear, a footprint of 5 texels is trilinear between levels 2 and 3
+	for (bool bCompressed : { false, true }) {
+		TextureMap diffuseMap, specularMap;
+		diffuseMap.setup(diffuse, TextureMap::Color, bCompressed);
+		specularMap.setup(specular, TextureMap::Specular, bCompressed);
+		floor.diffuseMap = &diffuseMap;
+		floor.specularMap = &specularMap;
+		string suffix = bCompressed ? " compressed (diffuse + specular)" : " (diffuse + specular)";
+
+		timeKernel(options, "texture lookup bilinear" + suffix, "lookup", numInputs, [&]() {
+			float sum = 0;
+			for (auto& c : coords) sum += floor.getDiffuse(c.x, c.y, 0).r + floor.getSpecular(c.x, c.y, 0);
+			benchSink = sum;
+		}, results);
+		timeKernel(options, "texture lookup trilinear" + suffix, "lookup", numInputs, [&]() {
+			float sum = 0, footprint = 5.0f / 1024;
+			for (auto& c : coords) sum += floor.getDiffuse(c.x, c.y, footprint).r + floor.getSpecular(c.x, c.y, footprint);
+			benchSink = sum;
+		}, results);
+	}
+}
+
+
+static void shadingBenchmarks(const BenchOptions& options, vector<BenchResult>& results) {
+	std::mt19937 rng(4);
+
+	// the app's default lights over the floor, with some spheres to cast shadows
+	RenderScene scene;
+	scene.objects.push_back(makeBenchFloor());
+	std::uniform_real_distribution<float> radius(0.3, 1);
+	for (int i = 0; i < 20; i++) {
+		RenderObject sphere;
+		sphere.position = randomIn(rng, glm::vec3(0, 1, 0), glm::vec3(8, 2, 8));
+		sphere.radius = radius(rng);
+		sphere.diffuseColor = ofColor::lightBlue;
+		scene.objects.push_back(sphere);
+	}
+	addDefaultLights(scene);
+	scene.settings.width = scene.settings.height = 64;	// only sizes buffers that aren't used
+	scene.view = RenderView::lookAt(glm::vec3(0, 2, 10), glm::vec3(0), glm::vec3(0, 1, 0), 60, 1);
+
+	vector<glm::vec3> points(numInputs / 8);
+	for (auto& p : points) p = randomIn(rng, glm::vec3(0, -2, 0), glm::vec3(10, 0, 10));
+	glm::vec3 up(0, 1, 0);
+
+	Renderer renderer;
+	auto shadeFloor = [&]() {
+		float sum = 0;
+		for (auto& p : points) sum += renderer.shadePoint(0, p, up).r;
+		benchSink = sum;
+	};
+
+	scene.settings.lambert = true;
+	renderer.prepare(scene);
+	timeKernel(options, "Renderer::lambert 3 lights (102 samples)", "point", (int)points.size(), shadeFloor, results);
+
+	scene.settings.lambert = false;
+	scene.settings.phong = true;
+	renderer.prepare(scene);
+	timeKernel(options, "Renderer::phong 3 lights (102 samples)", "point", (int)points.size(), shadeFloor, results);
+}
+
+
+void runMicrobenchmarks(const BenchOptions& options, vector<BenchResult>& results) {
+	intersectionBenchmarks(options, results);
+	lightBenchmarks(options, results);
+	textureBenchmarks(options, results);
+	shadingBenchmarks(options, results);
+}
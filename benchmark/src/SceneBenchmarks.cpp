@@ -0,0 +1,122 @@
+#include "Benchmark.h"
+#include "SceneFile.h"
+#include <thread>
+
+
+// floor, the default lights and n spheres in front of the camera, smaller the more there are
+static void makeSphereScene(int n, SceneDescription& desc) {
+	std::mt19937 rng(n);
+	std::uniform_real_distribution<float> r(-1, 1);
+	std::uniform_int_distribution<int> hue(0, 255);
+	float radius = std::min(1.0, cbrt(20.0 / n));
+
+	desc.addObject(makeBenchFloor());
+	for (int i = 0; i < n; i++) {
+		RenderObject sphere;
+		sphere.position = glm::vec3(0, 2, -4) + glm::vec3(8, 4, 6) * glm::vec3(r(rng), r(rng), r(rng));
+		sphere.radius = radius;
+		sphere.diffuseColor = ofColor::fromHsb(hue(rng), 160, 230);
+		desc.addObject(sphere);
+	}
+	addDefaultLights(desc.scene);
+}
+
+// floor, 100 spheres and a grid of n point lights above them, sharing the
+// default point lights' total intensity
+static void makeLightScene(int n, SceneDescription& desc) {
+	makeSphereScene(100, desc);
+	desc.scene.lights.clear();
+
+	int side = (int)ceil(sqrt((double)n));
+	for (int i = 0; i < n; i++) {
+		RenderLight light;
+		light.position = glm::vec3(ofMap(i % side + 0.5f, 0, side, -8, 8), 10, ofMap(i / side + 0.5f, 0, side, -8, 8));
+		light.intensity = 300.0f / n;
+		desc.scene.lights.push_back(light);
+	}
+}
+
+// corpus scenes, smallest first since peak memory is only tracked for the whole process
+static vector<string> getSceneNames(const BenchOptions& options) {
+	vector<string> names = { "default", "room" };
+	for (int n = 1; n <= options.maxLights; n *= 10) names.push_back("lights-" + ofToString(n));
+	for (int n = 10; n <= options.maxSpheres; n *= 10) names.push_back("spheres-" + ofToString(n));
+	return names;
+}
+
+// the files of the corpus are read from options.corpus, the others are generated
+static bool makeScene(const string& name, const BenchOptions& options, SceneDescription& desc) {
+	if (name == "default" || name == "room") {
+		return loadScene(ofFilePath::join(options.corpus, name + ".scene"), desc);
+	}
+
+	desc = SceneDescription();
+	int n = ofToInt(name.substr(name.find('-') + 1));
+	if (ofIsStringInString(name, "lights")) makeLightScene(n, desc);
+	else makeSphereScene(n, desc);
+
+	RenderSettings& settings = desc.scene.settings;
+	settings.phong = true;
+	settings.phongPower = 10;
+	return true;
+}
+
+
+void runSceneBenchmarks(const BenchOptions& options, vector<SceneResult>& results) {
+	vector<int> threadCounts = options.threads;
+	if (threadCounts.empty()) {
+		int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+		for (int t = 1; t < cores; t *= 2) threadCounts.push_back(t);
+		threadCounts.push_back(cores);
+	}
+
+	for (auto& name : getSceneNames(options)) {
+		if (!options.filter.empty() && name.find(options.filter) == string::npos) continue;
+
+		SceneDescription desc;
+		if (!makeScene(name, options, desc)) {
+			ofLogError("Benchmark") << "can't load scene " << name;
+			continue;
+		}
+
+		// every scene renders at the same size, so times compare across scenes
+		RenderSettings& settings = desc.scene.settings;
+		settings.width = options.width;
+		settings.height = options.height;
+		settings.passes = options.passes;
+		settings.progressive = options.passes > 1;
+		desc.update();
+
+		Renderer renderer;
+		ofPixels pixels;
+		double oneThreadMs = 0;
+		for (int threads : threadCounts) {
+			settings.threads = threads;
+			double best = 1e30;
+			for (int run = 0; run < options.sceneRuns; run++) {
+				double start = benchTime();
+				renderer.render(desc.scene, pixels);
+				best = std::min(best, benchTime() - start);
+			}
+
+			SceneResult result;
+			result.name = name + " t" + ofToString(threads);
+			result.scene = name;
+			result.threads = threads;
+			result.objects = (int)desc.scene.objects.size();
+			result.lights = (int)desc.scene.lights.size();
+			result.width = settings.width;
+			result.height = settings.height;
+			result.passes = settings.passes;
+			result.ms = best * 1000;
+			result.raysPerSecond = (double)settings.width * settings.height * settings.passes / best;
+			if (threads == 1) oneThreadMs = result.ms;
+			if (oneThreadMs > 0) result.speedup = oneThreadMs / result.ms;
+			result.peakMemoryMB = getPeakMemory() / (1024.0 * 1024.0);
+			results.push_back(result);
+
+			printf("%-20s %3d threads %10.1f ms %8.2f Mrays/s %6.2fx %8.0f MB\n", name.c_str(), threads,
+				result.ms, result.raysPerSecond / 1e6, result.speedup, result.peakMemoryMB);
+		}
+	}
+}
@@ -0,0 +1,110 @@
+#include "ofMain.h"
+#include "Benchmark.h"
+
+//  Benchmarks of the renderer.
+//
+//  By default every kernel of the hot paths (intersection, light sampling,
+//  texturing, shading) is timed in isolation and reported as ns/op plus rays/s
+//  or ops/s.  With -scenes, full frames of a scene corpus are rendered instead:
+//  the default scene, a textured room and generated scenes with 10 to 1,000,000
+//  spheres and 1 to 1,000 lights, each with a range of thread counts.  Results
+//  are printed as a table and written as json.
+//
+//  usage: raytracer-benchmark [options]
+//    -o <file>              json output (default microbench.json or scenes.json)
+//    -filter <text>         only run benchmarks / scenes whose name contains text
+//    -time <s>              kernels: seconds per run (default 0.2)
+//    -runs <n>              runs per benchmark or scene, the fastest is reported (default 5 / 3)
+//    -scenes                render the scene corpus
+//    -corpus <dir>          directory of default.scene and room.scene (default bin/data/scenes)
+//    -threads <n,n,..>      thread counts to render with (default 1, 2, 4 .. all cores)
+//    -w <width> -h <height> image size (default 400 x 300)
+//    -passes <n>            progressive passes per frame (default 1)
+//    -max-spheres <n>       largest generated scene (default 1000000)
+//    -max-lights <n>        most lights in a generated scene (default 1000)
+//    -save-baseline <file>  also write the results to file, to compare later runs against
+//    -baseline <file>       compare against a saved baseline, exits with 2 if anything
+//                           is slower by more than the tolerance
+//    -tolerance <x>         allowed slowdown, 0.1 = 10% (default 0.15)
+
+static void usage() {
+	printf("usage: raytracer-benchmark [-o file] [-filter text] [-time seconds] [-runs n]\n"
+		"       [-scenes] [-corpus dir] [-threads n,n,..] [-w width] [-h height] [-passes n]\n"
+		"       [-max-spheres n] [-max-lights n] [-save-baseline file] [-baseline file] [-tolerance x]\n");
+}
+
+//========================================================================
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+	bool bScenes = false;
+	string output, baseline, saveBaseline;
+	double tolerance = 0.15;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool bHasValue = i + 1 < argc;
+		if (arg == "-o" && bHasValue) output = argv[++i];
+		else if (arg == "-filter" && bHasValue) options.filter = argv[++i];
+		else if (arg == "-time" && bHasValue) options.minTime = std::max(ofToDouble(argv[++i]), 0.001);
+		else if (arg == "-runs" && bHasValue) options.runs = options.sceneRuns = std::max(ofToInt(argv[++i]), 1);
+		else if (arg == "-scenes") bScenes = true;
+		else if (arg == "-corpus" && bHasValue) options.corpus = argv[++i];
+		else if (arg == "-threads" && bHasValue) {
+			for (auto& t : ofSplitString(argv[++i], ",", true, true)) options.threads.push_back(std::max(ofToInt(t), 1));
+		}
+		else if (arg == "-w" && bHasValue) options.width = std::max(ofToInt(argv[++i]), 1);
+		else if (arg == "-h" && bHasValue) options.height = std::max(ofToInt(argv[++i]), 1);
+		else if (arg == "-passes" && bHasValue) options.passes = std::max(ofToInt(argv[++i]), 1);
+		else if (arg == "-max-spheres" && bHasValue) options.maxSpheres = ofToInt(argv[++i]);
+		else if (arg == "-max-lights" && bHasValue) options.maxLights = ofToInt(argv[++i]);
+		else if (arg == "-save-baseline" && bHasValue) saveBaseline = argv[++i];
+		else if (arg == "-baseline" && bHasValue) baseline = argv[++i];
+		else if (arg == "-tolerance" && bHasValue) tolerance = ofToDouble(argv[++i]);
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (output.empty()) output = bScenes ? "scenes.json" : "microbench.json";
+
+	// read the baseline first, so a bad path doesn't waste a whole run
+	vector<BenchMetric> baselineMetrics;
+	if (!baseline.empty() && !readBaseline(baseline, baselineMetrics)) return 1;
+
+	vector<BenchMetric> metrics;
+	vector<string> outputs = { output };
+	if (!saveBaseline.empty()) outputs.push_back(saveBaseline);
+
+	if (bScenes) {
+		ofInit();
+		vector<SceneResult> results;
+		runSceneBenchmarks(options, results);
+		for (auto& path : outputs) {
+			if (!writeSceneJson(ofFilePath::getAbsolutePath(path, false), results)) return 1;
+		}
+		metrics = getMetrics(results);
+	}
+	else {
+		// scene objects set up their ofxGui panels, which needs a gl context: use a hidden window's
+		ofGLFWWindowSettings settings;
+		settings.visible = false;
+		ofCreateWindow(settings);
+
+		vector<BenchResult> results;
+		runMicrobenchmarks(options, results);
+		for (auto& path : outputs) {
+			if (!writeBenchJson(ofFilePath::getAbsolutePath(path, false), results)) return 1;
+		}
+		metrics = getMetrics(results);
+	}
+	for (auto& path : outputs) printf("wrote %s\n", ofFilePath::getAbsolutePath(path, false).c_str());
+
+	if (!baseline.empty()) {
+		int regressions = compareToBaseline(metrics, baselineMetrics, tolerance);
+		if (regressions > 0) {
+			printf("%d benchmark(s) slower than the baseline by more than %.0f%%\n", regressions, tolerance * 100);
+			return 2;
+		}
+		printf("no regressions\n");
+	}
+	return 0;
+}
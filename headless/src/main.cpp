@@ -0,0 +1,152 @@
+#include "ofMain.h"
+#include "Renderer.h"
+#include "SceneFile.h"
+#include <filesystem>
+
+//  Headless batch renderer: renders a scene file to an image without a window
+//  or GL context, with the same renderer and shading as the app.
+//
+//  usage: raytracer-headless <scene file> [options]
+//    -o <file>       output image (default render.png)
+//    -w <width>      image width, overrides the scene
+//    -h <height>     image height
+//    -t <threads>    render threads, 0 = all cores
+//    -passes <n>     progressive passes (anti-aliasing and area light samples)
+//    -packets        trace primary rays as 8x8 packets
+//    -sampler <type> random, halton, sobol or bluenoise pattern of jitter and light samples
+//    -seed <n>       sampler seed: renders with the same seed come out bit identical
+//    -aa <n>         adaptive anti-aliasing, up to n samples in pixels that differ from their neighbors
+//    -aa-threshold <t>  brightness difference in [0, 1] that gets supersampled (default 0.1)
+//    -denoise        filter area light noise out of the image (see Denoiser.h)
+//    -shadow-rate <n>  trace area light shadows once per n x n pixels (2 = half, 4 = quarter resolution)
+//    -aux            also write the normal, depth, albedo and object id buffers next to the image
+//    -compressed-textures  keep texture maps block compressed, a fraction of the memory
+//
+//  raytracer-headless -convert-textures <dir> writes the texture cache files
+//  (see TextureCache.h) of every image under dir ahead of time instead, so
+//  not even the first run of the app has to decode them.  Add
+//  -compressed-textures to write compressed ones.
+
+static void usage() {
+	printf("usage: raytracer-headless <scene file> [-o file] [-w width] [-h height] [-t threads] [-passes n] [-packets]\n"
+		"       [-sampler random|halton|sobol|bluenoise] [-seed n] [-aa n] [-aa-threshold t]\n"
+		"       [-denoise] [-aux] [-shadow-rate n] [-compressed-textures]\n"
+		"       raytracer-headless -convert-textures <dir> [-compressed-textures]\n");
+}
+
+// write the cache files of every image under dir, in parallel
+static int convertTextures(const string& dir, bool bCompressed) {
+	vector<string> images;
+	std::error_code error;
+	for (auto& entry : std::filesystem::recursive_directory_iterator(ofToDataPath(dir, true), error)) {
+		string ext = ofToLower(entry.path().extension().string());
+		if (entry.is_regular_file() && (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".tga" || ext == ".bmp")) {
+			images.push_back(entry.path().string());
+		}
+	}
+	if (error) {
+		printf("can't read %s\n", dir.c_str());
+		return 1;
+	}
+
+	std::atomic<int> failed(0);
+	ThreadPool pool;
+	pool.parallelFor((int)images.size(), [&](int i) {
+		if (TextureCache::convert(images[i], bCompressed)) printf("converted %s\n", images[i].c_str());
+		else failed++;
+	});
+	printf("%d of %d textures converted\n", (int)images.size() - failed, (int)images.size());
+	return failed > 0 ? 1 : 0;
+}
+
+//========================================================================
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		usage();
+		return 1;
+	}
+	ofInit();
+
+	// textures are loaded with the scene, so their format has to be known first
+	bool bCompressedTextures = false;
+	for (int i = 2; i < argc; i++) {
+		if (string(argv[i]) == "-compressed-textures") bCompressedTextures = true;
+	}
+	getTextureCache().setCompressed(bCompressedTextures);
+
+	if (string(argv[1]) == "-convert-textures") {
+		if (argc < 3 || argc > 4 || (argc == 4 && !bCompressedTextures)) {
+			usage();
+			return 1;
+		}
+		return convertTextures(argv[2], bCompressedTextures);
+	}
+
+	SceneDescription desc;
+	if (!loadScene(argv[1], desc)) return 1;
+
+	// command line settings override the scene's
+	RenderSettings& settings = desc.scene.settings;
+	string output = "render.png";
+	bool bAux = false;
+	for (int i = 2; i < argc; i++) {
+		string arg = argv[i];
+		bool bHasValue = i + 1 < argc;
+		if (arg == "-o" && bHasValue) output = argv[++i];
+		else if (arg == "-w" && bHasValue) settings.width = ofToInt(argv[++i]);
+		else if (arg == "-h" && bHasValue) settings.height = ofToInt(argv[++i]);
+		else if (arg == "-t" && bHasValue) settings.threads = ofToInt(argv[++i]);
+		else if (arg == "-passes" && bHasValue) {
+			settings.passes = std::max(ofToInt(argv[++i]), 1);
+			settings.progressive = settings.passes > 1;
+		}
+		else if (arg == "-packets") settings.packetTracing = true;
+		else if (arg == "-sampler" && bHasValue) {
+			if (!Sampler::getType(argv[++i], settings.sampler)) {
+				usage();
+				return 1;
+			}
+		}
+		else if (arg == "-seed" && bHasValue) settings.seed = ofToInt(argv[++i]);
+		else if (arg == "-aa" && bHasValue) {
+			settings.aaMaxSamples = std::max(ofToInt(argv[++i]), 1);
+			settings.adaptiveAA = true;
+		}
+		else if (arg == "-aa-threshold" && bHasValue) settings.aaThreshold = ofToFloat(argv[++i]);
+		else if (arg == "-denoise") settings.denoise = true;
+		else if (arg == "-aux") bAux = true;
+		else if (arg == "-shadow-rate" && bHasValue) settings.shadowRate = std::max(ofToInt(argv[++i]), 1);
+		else if (arg == "-compressed-textures") continue;
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (settings.width <= 0 || settings.height <= 0) {
+		usage();
+		return 1;
+	}
+	desc.update(); // view depends on the image size
+
+	printf("rendering %s: %d objects, %d lights, %d x %d\n", argv[1], (int)desc.scene.objects.size(),
+		(int)desc.scene.lights.size(), settings.width, settings.height);
+
+	Renderer renderer;
+	ofPixels pixels;
+	uint64_t start = ofGetElapsedTimeMillis();
+	renderer.render(desc.scene, pixels);
+	printf("rendered in %.3f s\n", (ofGetElapsedTimeMillis() - start) / 1000.0);
+	if (settings.denoise) printf("denoised in %.3f s\n", renderer.getStats().denoiseSeconds);
+
+	output = ofFilePath::getAbsolutePath(output, false);
+	if (!ofSaveImage(pixels, output)) {
+		printf("can't write %s\n", output.c_str());
+		return 1;
+	}
+	printf("wrote %s\n", output.c_str());
+	if (bAux && !renderer.getAuxBuffers().save(output)) {
+		printf("can't write the aux buffers of %s\n", output.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+
+static const int numBins = 16;
+static const int maxDepth = 60;				// traversal stacks hold 64 entries
+static const int parallelSubtreeSize = 4096;	// build subtrees larger than this as separate tasks
+static const int parallelBinSize = 65536;	// bin nodes larger than this in parallel chunks
+
+// shared state of one build
+struct Bvh::BuildJob {
+	const std::vector<Aabb>* primBounds;
+	std::vector<glm::vec3> centroids;
+	ThreadPool* pool;
+	int maxLeafSize;
+	std::atomic<int> nodeCount;
+};
+
+namespace {
+	struct Bin {
+		Aabb bounds;
+		int count = 0;
+	};
+
+	// bounds of the primitives and of their centroids over a range of primIndices
+	struct RangeBounds {
+		Aabb bounds, centroidBounds;
+		Bin bins[3][numBins];
+
+		void merge(const RangeBounds& other) {
+			bounds.grow(other.bounds);
+			centroidBounds.grow(other.centroidBounds);
+		}
+		void mergeBins(const RangeBounds& other) {
+			for (int a = 0; a < 3; a++) {
+				for (int b = 0; b < numBins; b++) {
+					bins[a][b].bounds.grow(other.bins[a][b].bounds);
+					bins[a][b].count += other.bins[a][b].count;
+				}
+			}
+		}
+	};
+
+	int binIndex(float c, float lo, float scale) {
+		int b = (int)((c - lo) * scale);
+		return std::min(std::max(b, 0), numBins - 1);
+	}
+}
+
+void Bvh::build(const std::vector<Aabb>& primBounds, ThreadPool* pool, int maxLeafSize) {
+	clear();
+	int n = (int)primBounds.size();
+	if (n == 0) return;
+
+	BuildJob job;
+	job.primBounds = &primBounds;
+	job.pool = pool;
+	job.maxLeafSize = std::max(maxLeafSize, 1);
+	job.nodeCount = 1;
+	job.centroids.resize(n);
+
+	primIndices.resize(n);
+	for (int i = 0; i < n; i++) {
+		primIndices[i] = i;
+		job.centroids[i] = primBounds[i].center();
+	}
+
+	// a binary tree with n leaves has at most 2n - 1 nodes
+	nodes.resize(2 * n - 1);
+	buildNode(job, 0, 0, n, 0);
+	nodes.resize(job.nodeCount);
+}
+
+void Bvh::buildNode(BuildJob& job, int nodeIndex, int begin, int end, int depth) {
+	const std::vector<Aabb>& primBounds = *job.primBounds;
+	int count = end - begin;
+
+	// big nodes are scanned in chunks on the pool, the partial results are merged
+	int numChunks = (job.pool && count > parallelBinSize) ? job.pool->size() * 4 : 1;
+	RangeBounds local;
+	std::vector<RangeBounds> chunks;
+	auto forChunks = [&](const std::function<void(int, int, RangeBounds&)>& fn) {
+		if (numChunks == 1) {
+			fn(begin, end, local);
+			return;
+		}
+		chunks.resize(numChunks);
+		job.pool->parallelFor(numChunks, [&](int c) {
+			int from = begin + (int)((long long)count * c / numChunks);
+			int to = begin + (int)((long long)count * (c + 1) / numChunks);
+			fn(from, to, chunks[c]);
+		});
+	};
+
+	// bounds of this node and of the primitive centroids
+	forChunks([&](int from, int to, RangeBounds& rb) {
+		for (int i = from; i < to; i++) {
+			rb.bounds.grow(primBounds[primIndices[i]]);
+			rb.centroidBounds.grow(job.centroids[primIndices[i]]);
+		}
+	});
+	for (auto& chunk : chunks) local.merge(chunk);
+
+	BvhNode& node = nodes[nodeIndex];
+	node.bounds = local.bounds;
+	node.first = begin;
+	node.count = count;
+	if (count <= job.maxLeafSize || depth >= maxDepth) return;
+
+	Aabb centroidBounds = local.centroidBounds;
+	glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+	int split = begin + count / 2;
+
+	if (extent.x > 0 || extent.y > 0 || extent.z > 0) {
+		// bin centroids along all three axes
+		glm::vec3 scale;
+		for (int a = 0; a < 3; a++) scale[a] = (extent[a] > 0) ? numBins / extent[a] : 0;
+		forChunks([&](int from, int to, RangeBounds& rb) {
+			for (int i = from; i < to; i++) {
+				const glm::vec3& c = job.centroids[primIndices[i]];
+				for (int a = 0; a < 3; a++) {
+					Bin& bin = rb.bins[a][binIndex(c[a], centroidBounds.min[a], scale[a])];
+					bin.bounds.grow(primBounds[primIndices[i]]);
+					bin.count++;
+				}
+			}
+		});
+		for (auto& chunk : chunks) local.mergeBins(chunk);
+
+		// sweep the bins to find the split with the lowest SAH cost
+		int bestAxis = -1, bestBin = 0;
+		float bestCost = FLT_MAX;
+		for (int a = 0; a < 3; a++) {
+			if (extent[a] <= 0) continue;
+			const Bin* bins = local.bins[a];
+
+			float rightArea[numBins];
+			int rightCount[numBins];
+			Aabb box;
+			int n = 0;
+			for (int b = numBins - 1; b > 0; b--) {
+				box.grow(bins[b].bounds);
+				n += bins[b].count;
+				rightArea[b] = box.area();
+				rightCount[b] = n;
+			}
+
+			box = Aabb();
+			n = 0;
+			for (int b = 0; b < numBins - 1; b++) {
+				box.grow(bins[b].bounds);
+				n += bins[b].count;
+				float cost = n * box.area() + rightCount[b + 1] * rightArea[b + 1];
+				if (n > 0 && rightCount[b + 1] > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = a;
+					bestBin = b;
+				}
+			}
+		}
+
+		// keep small nodes as leaves when splitting does not pay off
+		// (one traversal step costs about as much as one primitive test)
+		float area = node.bounds.area();
+		float splitCost = 1 + ((area > 0) ? bestCost / area : 0);
+		if (bestAxis < 0 || (splitCost >= count && count <= 4 * job.maxLeafSize)) return;
+
+		float lo = centroidBounds.min[bestAxis];
+		float s = scale[bestAxis];
+		int* first = primIndices.data() + begin;
+		int* mid = std::partition(first, first + count, [&](int prim) {
+			return binIndex(job.centroids[prim][bestAxis], lo, s) <= bestBin;
+		});
+		split = begin + (int)(mid - first);
+	}
+	// else every centroid is the same, just split the list in half
+
+	int left = job.nodeCount.fetch_add(2);
+	node.first = left;
+	node.count = 0;
+
+	// children of big nodes are built as separate tasks, stolen by idle workers
+	if (job.pool && count > parallelSubtreeSize) {
+		job.pool->parallelFor(2, [&](int child) {
+			if (child == 0) buildNode(job, left, begin, split, depth + 1);
+			else buildNode(job, left + 1, split, end, depth + 1);
+		});
+	}
+	else {
+		buildNode(job, left, begin, split, depth + 1);
+		buildNode(job, left + 1, split, end, depth + 1);
+	}
+}
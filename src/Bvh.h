@@ -0,0 +1,245 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+
+//  Axis aligned bounding box
+struct Aabb {
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	void grow(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+	void grow(const Aabb& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+	bool isEmpty() const { return min.x > max.x; }
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+
+	float area() const {
+		if (isEmpty()) return 0;
+		glm::vec3 e = max - min;
+		return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	// slab test against [tMin, tMax], invDir = 1 / ray direction.  tNear is the entry distance.
+	bool intersect(const glm::vec3& origin, const glm::vec3& invDir, float tMax, float& tNear, float tMin = 0) const {
+		glm::vec3 t0 = (min - origin) * invDir;
+		glm::vec3 t1 = (max - origin) * invDir;
+		glm::vec3 tSmall = glm::min(t0, t1);
+		glm::vec3 tBig = glm::max(t0, t1);
+		tNear = std::max(std::max(tSmall.x, tSmall.y), std::max(tSmall.z, tMin));
+		float tFar = std::min(std::min(tBig.x, tBig.y), std::min(tBig.z, tMax));
+		return tNear <= tFar;
+	}
+};
+
+
+//  Bundle of up to 64 coherent rays (e.g. an 8x8 block of primary rays),
+//  stored as arrays so box tests run over all rays at once
+struct RayPacket {
+	static const int maxRays = 64;
+
+	void set(int i, const glm::vec3& o, const glm::vec3& d) {
+		ox[i] = o.x; oy[i] = o.y; oz[i] = o.z;
+		dx[i] = d.x; dy[i] = d.y; dz[i] = d.z;
+		ix[i] = 1.0f / d.x; iy[i] = 1.0f / d.y; iz[i] = 1.0f / d.z;
+	}
+	glm::vec3 origin(int i) const { return glm::vec3(ox[i], oy[i], oz[i]); }
+	glm::vec3 dir(int i) const { return glm::vec3(dx[i], dy[i], dz[i]); }
+
+	// bit mask of the rays in active that enter the box before their tMax.
+	// If the first active ray hits, the node is taken for the whole packet and
+	// the others are sorted out at the leaves.
+	uint64_t intersect(const Aabb& box, const float* tMax, uint64_t active) const {
+		int first = 0;
+		while (!((active >> first) & 1)) first++;
+		if (hitsBox(box, first, tMax[first])) return active;
+
+		// written without branches so the compiler can vectorize it
+		float hit[maxRays];
+		for (int i = 0; i < count; i++) {
+			float t0 = (box.min.x - ox[i]) * ix[i], t1 = (box.max.x - ox[i]) * ix[i];
+			float tNear = t0 < t1 ? t0 : t1, tFar = t0 < t1 ? t1 : t0;
+			t0 = (box.min.y - oy[i]) * iy[i]; t1 = (box.max.y - oy[i]) * iy[i];
+			tNear = std::max(tNear, t0 < t1 ? t0 : t1); tFar = std::min(tFar, t0 < t1 ? t1 : t0);
+			t0 = (box.min.z - oz[i]) * iz[i]; t1 = (box.max.z - oz[i]) * iz[i];
+			tNear = std::max(tNear, t0 < t1 ? t0 : t1); tFar = std::min(tFar, t0 < t1 ? t1 : t0);
+			hit[i] = std::max(tNear, 0.0f) - std::min(tFar, tMax[i]);
+		}
+		uint64_t mask = 0;
+		for (int i = 0; i < count; i++) mask |= (uint64_t)(hit[i] <= 0) << i;
+		return mask & active;
+	}
+
+	bool hitsBox(const Aabb& box, int i, float tMax) const {
+		float tNear;
+		return box.intersect(origin(i), glm::vec3(ix[i], iy[i], iz[i]), tMax, tNear);
+	}
+
+	int count = 0;
+	float ox[maxRays], oy[maxRays], oz[maxRays];
+	float dx[maxRays], dy[maxRays], dz[maxRays];
+	float ix[maxRays], iy[maxRays], iz[maxRays];		// 1 / direction
+};
+
+
+struct BvhNode {
+	Aabb bounds;
+	int first;	// leaf: first entry in Bvh::primIndices, interior: left child (right child = first + 1)
+	int count;	// leaf: number of primitives, interior: 0
+};
+
+
+//  Bounding volume hierarchy over a list of primitive bounds, built with the
+//  surface area heuristic.  The Bvh only knows about boxes: queries hand every
+//  leaf they reach to a callback that tests the actual primitives.
+class Bvh {
+public:
+	// primitives are identified by their index in primBounds.  Large subtrees
+	// are built in parallel on the pool, if one is given.
+	void build(const std::vector<Aabb>& primBounds, ThreadPool* pool = nullptr, int maxLeafSize = 4);
+	void clear() { nodes.clear(); primIndices.clear(); }
+	bool isEmpty() const { return nodes.empty(); }
+
+	// closest hit: leafFn(first, count, tMax) tests primIndices[first .. first + count),
+	// shrinking tMax on a hit so farther nodes are culled.  Returns true if any leaf hit.
+	// root is the node to start from (0 = whole tree)
+	template <typename LeafFn>
+	bool closestHit(const glm::vec3& origin, const glm::vec3& dir, float& tMax, LeafFn leafFn, int root = 0) const;
+
+	// closest hit for a whole packet: nodes are visited once for all rays that reach
+	// them, leafFn(ray, first, count, tMax[ray]) tests one ray's leaf.  Once fewer
+	// than a quarter of the packet is still active in a subtree, the remaining rays
+	// finish it one at a time.
+	template <typename LeafFn>
+	void closestHitPacket(const RayPacket& packet, float* tMax, LeafFn leafFn) const;
+
+	// any hit in [tMin, tMax]: stops as soon as leafFn(first, count) reports a hit
+	template <typename LeafFn>
+	bool anyHit(const glm::vec3& origin, const glm::vec3& dir, float tMin, float tMax, LeafFn leafFn) const;
+
+	std::vector<BvhNode> nodes;		// nodes[0] is the root
+	std::vector<int> primIndices;	// primitive order referenced by the leaves
+
+private:
+	struct BuildJob;
+	void buildNode(BuildJob& job, int nodeIndex, int begin, int end, int depth);
+};
+
+
+template <typename LeafFn>
+bool Bvh::closestHit(const glm::vec3& origin, const glm::vec3& dir, float& tMax, LeafFn leafFn, int root) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 invDir = 1.0f / dir;
+	int stack[64];
+	int stackSize = 0;
+	int current = root;
+	bool hit = false;
+
+	float tNear;
+	if (!nodes[root].bounds.intersect(origin, invDir, tMax, tNear)) return false;
+
+	while (true) {
+		const BvhNode& node = nodes[current];
+		if (node.count > 0) {
+			if (leafFn(node.first, node.count, tMax)) hit = true;
+		}
+		else {
+			// visit the nearer child first, the other one may be culled by then
+			float tLeft, tRight;
+			bool hitLeft = nodes[node.first].bounds.intersect(origin, invDir, tMax, tLeft);
+			bool hitRight = nodes[node.first + 1].bounds.intersect(origin, invDir, tMax, tRight);
+			if (hitLeft && hitRight) {
+				if (tLeft <= tRight) { stack[stackSize++] = node.first + 1; current = node.first; }
+				else { stack[stackSize++] = node.first; current = node.first + 1; }
+				continue;
+			}
+			if (hitLeft) { current = node.first; continue; }
+			if (hitRight) { current = node.first + 1; continue; }
+		}
+
+		// pop the next node that is still closer than the current hit
+		bool found = false;
+		while (stackSize > 0) {
+			current = stack[--stackSize];
+			if (nodes[current].bounds.intersect(origin, invDir, tMax, tNear)) { found = true; break; }
+		}
+		if (!found) return hit;
+	}
+}
+
+template <typename LeafFn>
+bool Bvh::anyHit(const glm::vec3& origin, const glm::vec3& dir, float tMin, float tMax, LeafFn leafFn) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 invDir = 1.0f / dir;
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const BvhNode& node = nodes[stack[--stackSize]];
+		float tNear;
+		if (!node.bounds.intersect(origin, invDir, tMax, tNear, tMin)) continue;
+
+		if (node.count > 0) {
+			if (leafFn(node.first, node.count)) return true;
+		}
+		else {
+			stack[stackSize++] = node.first + 1;
+			stack[stackSize++] = node.first;
+		}
+	}
+	return false;
+}
+
+template <typename LeafFn>
+void Bvh::closestHitPacket(const RayPacket& packet, float* tMax, LeafFn leafFn) const {
+	if (nodes.empty() || packet.count == 0) return;
+
+	struct Entry { int node; uint64_t active; };
+	Entry stack[64];
+	int stackSize = 0;
+	uint64_t all = (packet.count == 64) ? ~0ull : ((1ull << packet.count) - 1);
+	stack[stackSize++] = Entry{ 0, all };
+	int divergent = std::max(packet.count / 4, 1);
+
+	while (stackSize > 0) {
+		Entry entry = stack[--stackSize];
+		const BvhNode& node = nodes[entry.node];
+		uint64_t active = packet.intersect(node.bounds, tMax, entry.active);
+		if (!active) continue;
+
+		int numActive = 0;
+		for (int i = 0; i < packet.count; i++) numActive += (active >> i) & 1;
+
+		if (node.count > 0 || numActive < divergent) {
+			for (int i = 0; i < packet.count; i++) {
+				if (!((active >> i) & 1)) continue;
+				if (node.count > 0) leafFn(i, node.first, node.count, tMax[i]);
+				else {
+					// packet has diverged, trace the rest of the subtree per ray
+					closestHit(packet.origin(i), packet.dir(i), tMax[i], [&](int first, int count, float& t) {
+						return leafFn(i, first, count, t);
+					}, entry.node);
+				}
+			}
+			continue;
+		}
+
+		// visit the child nearer along the first active ray first
+		int first = 0;
+		while (!((active >> first) & 1)) first++;
+		glm::vec3 o = packet.origin(first), d = packet.dir(first);
+		float tLeft = glm::dot(nodes[node.first].bounds.center() - o, d);
+		float tRight = glm::dot(nodes[node.first + 1].bounds.center() - o, d);
+		int nearChild = (tLeft <= tRight) ? node.first : node.first + 1;
+		int farChild = (tLeft <= tRight) ? node.first + 1 : node.first;
+		stack[stackSize++] = Entry{ farChild, active };
+		stack[stackSize++] = Entry{ nearChild, active };
+	}
+}
@@ -0,0 +1,134 @@
+#include "Denoiser.h"
+
+
+void AuxBuffers::allocate(int w, int h) {
+	width = w;
+	height = h;
+	size_t n = (size_t)w * h;
+	normals.assign(n, glm::vec3(0));
+	depths.assign(n, 0);
+	albedos.assign(n, glm::vec3(0));
+	ids.assign(n, -1);
+}
+
+bool AuxBuffers::save(const string& path) const {
+	string base = ofFilePath::removeExt(path);
+	float maxDepth = 0;
+	for (float depth : depths) maxDepth = std::max(maxDepth, depth);
+
+	ofPixels normal, depth, albedo, id;
+	normal.allocate(width, height, OF_PIXELS_RGB);
+	depth.allocate(width, height, OF_PIXELS_GRAY);
+	albedo.allocate(width, height, OF_PIXELS_RGB);
+	id.allocate(width, height, OF_PIXELS_RGB);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			glm::vec3 n = (normals[i] * 0.5f + glm::vec3(0.5f)) * 255.0f;
+			normal.setColor(x, y, ofColor(n.x, n.y, n.z));
+			depth.setColor(x, y, ofColor(maxDepth > 0 ? depths[i] / maxDepth * 255 : 0));
+			albedo.setColor(x, y, ofColor(albedos[i].x * 255, albedos[i].y * 255, albedos[i].z * 255));
+			id.setColor(x, y, ids[i] < 0 ? ofColor::black : ofColor::fromHsb((ids[i] * 47) % 256, 200, 230));
+		}
+	}
+	return ofSaveImage(normal, base + "_normal.png") && ofSaveImage(depth, base + "_depth.png") &&
+		ofSaveImage(albedo, base + "_albedo.png") && ofSaveImage(id, base + "_id.png");
+}
+
+
+// spline weights of the 5 taps along each axis
+static const float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+// allowed difference of lighting in the first iteration, halved in every later one
+static const float lightingSigma = 1;
+// allowed difference of depth, relative to the pixel's, per pixel of tap distance
+static const float depthSigma = 0.05;
+
+static float getLuma(const glm::vec3& c) {
+	return 0.299f * c.x + 0.587f * c.y + 0.114f * c.z;
+}
+
+// albedo the lighting is divided by: channels without any color are left as they are
+static float getDivisor(float albedo) {
+	return (albedo < 0.01f) ? 1 : albedo;
+}
+
+void Denoiser::denoise(const ofPixels& image, const AuxBuffers& aux, ofPixels& out, int iterations, ThreadPool& pool) {
+	int width = aux.width, height = aux.height;
+	size_t n = (size_t)width * height;
+	lighting[0].resize(n);
+	lighting[1].resize(n);
+	out = image;	// the background stays as it is
+
+	pool.parallelFor(height, [&](int y) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			ofColor c = image.getColor(x, y);
+			const glm::vec3& albedo = aux.albedos[i];
+			lighting[0][i] = glm::vec3(c.r / getDivisor(albedo.x), c.g / getDivisor(albedo.y), c.b / getDivisor(albedo.z)) / 255.0f;
+		}
+	});
+
+	float sigma = lightingSigma;
+	for (int it = 0; it < iterations; it++) {
+		const vector<glm::vec3>& in = lighting[it % 2];
+		vector<glm::vec3>& filtered = lighting[(it + 1) % 2];
+		pool.parallelFor(height, [&](int y) { filter(aux, in, filtered, y, 1 << it, sigma); });
+		sigma *= 0.5f;
+	}
+
+	const vector<glm::vec3>& result = lighting[iterations % 2];
+	pool.parallelFor(height, [&](int y) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			if (aux.ids[i] < 0) continue;
+			const glm::vec3& albedo = aux.albedos[i];
+			glm::vec3 c = result[i] * glm::vec3(getDivisor(albedo.x), getDivisor(albedo.y), getDivisor(albedo.z)) * 255.0f;
+			out.setColor(x, y, ofColor(std::min(c.x, 255.0f), std::min(c.y, 255.0f), std::min(c.z, 255.0f)));
+		}
+	});
+}
+
+// one iteration over row y, taps step pixels apart
+void Denoiser::filter(const AuxBuffers& aux, const vector<glm::vec3>& in, vector<glm::vec3>& out,
+	int y, int step, float sigma) const {
+	int width = aux.width, height = aux.height;
+	for (int x = 0; x < width; x++) {
+		size_t p = (size_t)y * width + x;
+		int id = aux.ids[p];
+		if (id < 0) {
+			out[p] = in[p];
+			continue;
+		}
+		const glm::vec3& normal = aux.normals[p];
+		float depthScale = 1 / (depthSigma * step * std::max(aux.depths[p], 1e-4f));
+		float luma = getLuma(in[p]);
+
+		glm::vec3 sum(0);
+		float weights = 0;
+		for (int dy = -2; dy <= 2; dy++) {
+			int qy = y + dy * step;
+			if (qy < 0 || qy >= height) continue;
+			for (int dx = -2; dx <= 2; dx++) {
+				int qx = x + dx * step;
+				if (qx < 0 || qx >= width) continue;
+				size_t q = (size_t)qy * width + qx;
+				if (aux.ids[q] != id) continue;
+
+				// normals: cos^64 of the angle between them
+				float w = std::max(glm::dot(normal, aux.normals[q]), 0.0f);
+				w *= w;
+				w *= w;
+				w *= w;
+				w *= w;
+				w *= w;
+				w *= w;
+				w *= kernel[dx + 2] * kernel[dy + 2];
+				w *= exp(-fabs(aux.depths[p] - aux.depths[q]) * depthScale - fabs(luma - getLuma(in[q])) / sigma);
+				sum += in[q] * w;
+				weights += w;
+			}
+		}
+		out[p] = sum / weights;		// never 0, the pixel itself has full weight
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ThreadPool.h"
+
+
+// what the primary ray through the center of every pixel hit, written by the
+// renderer alongside the image to guide the denoiser
+struct AuxBuffers {
+	int width = 0, height = 0;
+	vector<glm::vec3> normals;
+	vector<float> depths;		// distance from the camera
+	vector<glm::vec3> albedos;	// color of the surface before shading, in [0, 1]
+	vector<int> ids;			// index of the object in the scene, -1 where nothing was hit
+
+	// every pixel a miss
+	void allocate(int width, int height);
+
+	// save them as images next to path: <name>_normal.png, _depth.png, _albedo.png
+	// and _id.png.  False if one can't be written.
+	bool save(const string& path) const;
+};
+
+
+//  Edge-aware denoiser for renders with few area light samples per pixel: an
+//  a-trous wavelet filter (Dammertz et al., "Edge-Avoiding A-Trous Wavelet
+//  Transform for fast Global Illumination Filtering", 2010).
+//
+//  Every iteration blurs with a 5x5 kernel whose taps are twice as far apart as
+//  the last one's, so a few of them cover a wide area at 25 taps a pixel.  Taps
+//  count less the more their normal, depth or lighting differs from the
+//  pixel's, and not at all on another object, so edges stay sharp.  Only the
+//  lighting is filtered: the albedo is divided out first and multiplied back
+//  in after, which keeps textures as they were.
+class Denoiser {
+public:
+	// filter image into out, rows spread over pool
+	void denoise(const ofPixels& image, const AuxBuffers& aux, ofPixels& out, int iterations, ThreadPool& pool);
+
+private:
+	void filter(const AuxBuffers& aux, const vector<glm::vec3>& in, vector<glm::vec3>& out,
+		int y, int step, float sigma) const;
+
+	vector<glm::vec3> lighting[2];		// ping pong between iterations
+};
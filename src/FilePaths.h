@@ -0,0 +1,11 @@
+#pragma once
+
+#include "ofMain.h"
+#include <filesystem>
+
+
+// absolute path without "." or ".." parts, so the same file always has the same
+// path (texture cache keys, SceneDescription::texturePaths)
+inline string getNormalizedPath(const string& path) {
+	return std::filesystem::path(ofFilePath::getAbsolutePath(path, false)).lexically_normal().string();
+}
@@ -0,0 +1,332 @@
+#include "IntersectKernels.h"
+#include <cfloat>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define RT_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define RT_TARGET_AVX2
+	#else
+		#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+
+void SphereArrays::resize(int n) {
+	count = n;
+	for (auto a : { &cx, &cy, &cz, &radius }) a->assign(n + kernelWidth, 0.0f);
+}
+
+void PlaneArrays::resize(int n) {
+	count = n;
+	for (auto a : { &px, &py, &pz, &nx, &ny, &nz, &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+		a->assign(n + kernelWidth, 0.0f);
+	}
+}
+
+
+//--------------------------------------------------------------
+// scalar kernels
+// (the arithmetic is written in the same order as the simd versions so both
+// produce identical distances)
+
+// distance along the ray to sphere i, false if missed
+static inline bool sphereDistance(const SphereArrays& s, int i, const glm::vec3& o, const glm::vec3& d, float& t) {
+	float dx = s.cx[i] - o.x;
+	float dy = s.cy[i] - o.y;
+	float dz = s.cz[i] - o.z;
+	float tca = dx * d.x + dy * d.y + dz * d.z;
+	float d2 = (dx * dx + dy * dy + dz * dz) - tca * tca;
+	float r2 = s.radius[i] * s.radius[i];
+	if (d2 > r2) return false;
+
+	float thc = std::sqrt(r2 - d2);
+	t = (tca > thc + FLT_EPSILON) ? tca - thc : tca + thc;
+	return t > FLT_EPSILON;
+}
+
+// distance along the ray to plane i, false if missed or outside the plane's extent
+static inline bool planeDistance(const PlaneArrays& p, int i, const glm::vec3& o, const glm::vec3& d, float& t) {
+	float denom = d.x * p.nx[i] + d.y * p.ny[i] + d.z * p.nz[i];
+	if (std::fabs(denom) <= FLT_EPSILON) return false;
+
+	float num = (p.px[i] - o.x) * p.nx[i] + (p.py[i] - o.y) * p.ny[i] + (p.pz[i] - o.z) * p.nz[i];
+	t = num / denom;
+	if (!(t > 0)) return false;
+
+	float hx = o.x + t * d.x;
+	float hy = o.y + t * d.y;
+	float hz = o.z + t * d.z;
+	return hx > p.minX[i] && hx < p.maxX[i] && hy > p.minY[i] && hy < p.maxY[i] &&
+		hz > p.minZ[i] && hz < p.maxZ[i];
+}
+
+bool intersectSpheresScalar(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+	bool hit = false;
+	for (int i = first; i < first + count; i++) {
+		float t;
+		if (sphereDistance(spheres, i, o, d, t) && t < tMax) {
+			tMax = t;
+			hitIndex = i;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+bool intersectPlanesScalar(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+	bool hit = false;
+	for (int i = first; i < first + count; i++) {
+		float t;
+		if (planeDistance(planes, i, o, d, t) && t < tMax) {
+			tMax = t;
+			hitIndex = i;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+bool occludedSpheresScalar(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+	for (int i = first; i < first + count; i++) {
+		float t;
+		if (sphereDistance(spheres, i, o, d, t) && t > tMin && t < tMax) {
+			hitIndex = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool occludedPlanesScalar(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+	for (int i = first; i < first + count; i++) {
+		float t;
+		if (planeDistance(planes, i, o, d, t) && t > tMin && t < tMax) {
+			hitIndex = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+//--------------------------------------------------------------
+// 8-wide avx2 kernels
+
+#ifdef RT_X86
+
+// mask of the first n lanes
+RT_TARGET_AVX2 static inline __m256 laneMask(int n) {
+	__m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(n), lanes));
+}
+
+// distances to 8 spheres starting at i, returns the mask of lanes that hit before tMax
+RT_TARGET_AVX2 static inline __m256 sphereDistance8(const SphereArrays& s, int i, int n,
+	const __m256 o[3], const __m256 d[3], __m256 tMax, __m256& t) {
+	const __m256 eps = _mm256_set1_ps(FLT_EPSILON);
+
+	__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&s.cx[i]), o[0]);
+	__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&s.cy[i]), o[1]);
+	__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&s.cz[i]), o[2]);
+	__m256 tca = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, d[0]), _mm256_mul_ps(dy, d[1])), _mm256_mul_ps(dz, d[2]));
+	__m256 dd = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+	__m256 d2 = _mm256_sub_ps(dd, _mm256_mul_ps(tca, tca));
+	__m256 r = _mm256_loadu_ps(&s.radius[i]);
+	__m256 r2 = _mm256_mul_ps(r, r);
+	__m256 mask = _mm256_and_ps(laneMask(n), _mm256_cmp_ps(d2, r2, _CMP_LE_OQ));
+
+	__m256 thc = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(r2, d2), _mm256_setzero_ps()));
+	__m256 front = _mm256_cmp_ps(tca, _mm256_add_ps(thc, eps), _CMP_GT_OQ);
+	t = _mm256_blendv_ps(_mm256_add_ps(tca, thc), _mm256_sub_ps(tca, thc), front);
+
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+	return _mm256_and_ps(mask, _mm256_cmp_ps(t, tMax, _CMP_LT_OQ));
+}
+
+// distances to 8 planes starting at i, returns the mask of lanes that hit before tMax
+RT_TARGET_AVX2 static inline __m256 planeDistance8(const PlaneArrays& p, int i, int n,
+	const __m256 o[3], const __m256 d[3], __m256 tMax, __m256& t) {
+	const __m256 eps = _mm256_set1_ps(FLT_EPSILON);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	__m256 nx = _mm256_loadu_ps(&p.nx[i]);
+	__m256 ny = _mm256_loadu_ps(&p.ny[i]);
+	__m256 nz = _mm256_loadu_ps(&p.nz[i]);
+	__m256 denom = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], nx), _mm256_mul_ps(d[1], ny)), _mm256_mul_ps(d[2], nz));
+	__m256 mask = _mm256_and_ps(laneMask(n), _mm256_cmp_ps(_mm256_andnot_ps(signBit, denom), eps, _CMP_GT_OQ));
+
+	__m256 num = _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&p.px[i]), o[0]), nx),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&p.py[i]), o[1]), ny)),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&p.pz[i]), o[2]), nz));
+	t = _mm256_div_ps(num, denom);
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, tMax, _CMP_LT_OQ));
+
+	// hit point must be inside the plane's extent
+	__m256 hx = _mm256_add_ps(o[0], _mm256_mul_ps(t, d[0]));
+	__m256 hy = _mm256_add_ps(o[1], _mm256_mul_ps(t, d[1]));
+	__m256 hz = _mm256_add_ps(o[2], _mm256_mul_ps(t, d[2]));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(hx, _mm256_loadu_ps(&p.minX[i]), _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(hx, _mm256_loadu_ps(&p.maxX[i]), _CMP_LT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(hy, _mm256_loadu_ps(&p.minY[i]), _CMP_GT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(hy, _mm256_loadu_ps(&p.maxY[i]), _CMP_LT_OQ));
+	mask = _mm256_and_ps(mask, _mm256_cmp_ps(hz, _mm256_loadu_ps(&p.minZ[i]), _CMP_GT_OQ));
+	return _mm256_and_ps(mask, _mm256_cmp_ps(hz, _mm256_loadu_ps(&p.maxZ[i]), _CMP_LT_OQ));
+}
+
+// pick the closest of the hit lanes
+RT_TARGET_AVX2 static inline bool closestLane(__m256 t, __m256 mask, int base, float& tMax, int& hitIndex) {
+	int bits = _mm256_movemask_ps(mask);
+	if (!bits) return false;
+
+	float ts[kernelWidth];
+	_mm256_storeu_ps(ts, t);
+	for (int lane = 0; lane < kernelWidth; lane++) {
+		if ((bits & (1 << lane)) && ts[lane] < tMax) {
+			tMax = ts[lane];
+			hitIndex = base + lane;
+		}
+	}
+	return true;
+}
+
+#define RT_RAY_REGISTERS(o, d) \
+	__m256 ov[3] = { _mm256_set1_ps(o.x), _mm256_set1_ps(o.y), _mm256_set1_ps(o.z) }; \
+	__m256 dv[3] = { _mm256_set1_ps(d.x), _mm256_set1_ps(d.y), _mm256_set1_ps(d.z) };
+
+RT_TARGET_AVX2 static bool intersectSpheresAvx2(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+	RT_RAY_REGISTERS(o, d);
+	bool hit = false;
+	for (int i = first; i < first + count; i += kernelWidth) {
+		__m256 t;
+		__m256 mask = sphereDistance8(spheres, i, first + count - i, ov, dv, _mm256_set1_ps(tMax), t);
+		if (closestLane(t, mask, i, tMax, hitIndex)) hit = true;
+	}
+	return hit;
+}
+
+RT_TARGET_AVX2 static bool intersectPlanesAvx2(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+	RT_RAY_REGISTERS(o, d);
+	bool hit = false;
+	for (int i = first; i < first + count; i += kernelWidth) {
+		__m256 t;
+		__m256 mask = planeDistance8(planes, i, first + count - i, ov, dv, _mm256_set1_ps(tMax), t);
+		if (closestLane(t, mask, i, tMax, hitIndex)) hit = true;
+	}
+	return hit;
+}
+
+// index of the first lane set in a hit mask
+static inline int firstLane(int bits) {
+	int lane = 0;
+	while (!(bits & (1 << lane))) lane++;
+	return lane;
+}
+
+RT_TARGET_AVX2 static bool occludedSpheresAvx2(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+	RT_RAY_REGISTERS(o, d);
+	__m256 tMinV = _mm256_set1_ps(tMin);
+	__m256 tMaxV = _mm256_set1_ps(tMax);
+	for (int i = first; i < first + count; i += kernelWidth) {
+		__m256 t;
+		__m256 mask = sphereDistance8(spheres, i, first + count - i, ov, dv, tMaxV, t);
+		int bits = _mm256_movemask_ps(_mm256_and_ps(mask, _mm256_cmp_ps(t, tMinV, _CMP_GT_OQ)));
+		if (bits) {
+			hitIndex = i + firstLane(bits);
+			return true;
+		}
+	}
+	return false;
+}
+
+RT_TARGET_AVX2 static bool occludedPlanesAvx2(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+	RT_RAY_REGISTERS(o, d);
+	__m256 tMinV = _mm256_set1_ps(tMin);
+	__m256 tMaxV = _mm256_set1_ps(tMax);
+	for (int i = first; i < first + count; i += kernelWidth) {
+		__m256 t;
+		__m256 mask = planeDistance8(planes, i, first + count - i, ov, dv, tMaxV, t);
+		int bits = _mm256_movemask_ps(_mm256_and_ps(mask, _mm256_cmp_ps(t, tMinV, _CMP_GT_OQ)));
+		if (bits) {
+			hitIndex = i + firstLane(bits);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	return avx2 && osxsave && ((_xgetbv(0) & 6) == 6);
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool bSimd = cpuHasAvx2();
+static const bool bSimdSupported = bSimd;
+
+#else
+
+static bool bSimd = false;
+static const bool bSimdSupported = false;
+
+#endif
+
+
+//--------------------------------------------------------------
+// dispatch
+
+bool hasSimdKernels() { return bSimdSupported; }
+void setSimdKernels(bool enabled) { bSimd = enabled && bSimdSupported; }
+
+bool intersectSpheres(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+#ifdef RT_X86
+	if (bSimd) return intersectSpheresAvx2(spheres, first, count, o, d, tMax, hitIndex);
+#endif
+	return intersectSpheresScalar(spheres, first, count, o, d, tMax, hitIndex);
+}
+
+bool intersectPlanes(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex) {
+#ifdef RT_X86
+	if (bSimd) return intersectPlanesAvx2(planes, first, count, o, d, tMax, hitIndex);
+#endif
+	return intersectPlanesScalar(planes, first, count, o, d, tMax, hitIndex);
+}
+
+bool occludedSpheres(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+#ifdef RT_X86
+	if (bSimd) return occludedSpheresAvx2(spheres, first, count, o, d, tMin, tMax, hitIndex);
+#endif
+	return occludedSpheresScalar(spheres, first, count, o, d, tMin, tMax, hitIndex);
+}
+
+bool occludedPlanes(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex) {
+#ifdef RT_X86
+	if (bSimd) return occludedPlanesAvx2(planes, first, count, o, d, tMin, tMax, hitIndex);
+#endif
+	return occludedPlanesScalar(planes, first, count, o, d, tMin, tMax, hitIndex);
+}
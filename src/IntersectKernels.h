@@ -0,0 +1,63 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <vector>
+
+
+//  Structure-of-arrays storage for render-side geometry.  Each array is padded
+//  with kernelWidth extra entries so the kernels can always load a full
+//  group of 8, lanes past the end of a range are masked off.
+
+static const int kernelWidth = 8;
+
+struct SphereArrays {
+	std::vector<float> cx, cy, cz;		// center
+	std::vector<float> radius;
+	int count = 0;
+
+	void resize(int n);
+};
+
+// finite axis-aligned planes: hit if the ray meets the plane inside the (flat) box
+struct PlaneArrays {
+	std::vector<float> px, py, pz;		// point on plane
+	std::vector<float> nx, ny, nz;		// normal
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;	// extent of the plane
+	int count = 0;
+
+	void resize(int n);
+};
+
+
+//  Ray vs. many primitive kernels, over the index range [first, first + count).
+//  Every kernel tests 8 primitives per step with AVX2 when the cpu supports it
+//  and otherwise falls back to the scalar versions, which give the same hits.
+//  Hits match glm::intersectRaySphere / glm::intersectRayPlane.
+
+// closest hit closer than tMax: updates tMax and hitIndex, returns true if one was found
+bool intersectSpheres(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex);
+bool intersectPlanes(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex);
+
+// true if any primitive is hit between tMin and tMax, hitIndex is set to one of them.
+// Returns on the first group of 8 with a hit.
+bool occludedSpheres(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex);
+bool occludedPlanes(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex);
+
+// scalar versions, always available
+bool intersectSpheresScalar(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex);
+bool intersectPlanesScalar(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float& tMax, int& hitIndex);
+bool occludedSpheresScalar(const SphereArrays& spheres, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex);
+bool occludedPlanesScalar(const PlaneArrays& planes, int first, int count,
+	const glm::vec3& o, const glm::vec3& d, float tMin, float tMax, int& hitIndex);
+
+// whether the 8-wide kernels are compiled in and supported by this cpu,
+// setSimdKernels(false) forces the scalar paths (e.g. for comparisons)
+bool hasSimdKernels();
+void setSimdKernels(bool enabled);
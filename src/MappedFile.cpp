@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		close();
+		return false;
+	}
+	bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!bytes) {
+		close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	bytes = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		close();
+		return false;
+	}
+	void* p = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		close();
+		return false;
+	}
+	bytes = (const char*)p;
+	length = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes) munmap((void*)bytes, length);
+	if (fd >= 0) ::close(fd);
+	bytes = nullptr;
+	length = 0;
+	fd = -1;
+}
+
+#endif
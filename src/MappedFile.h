@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+//  Read-only memory mapped file.  The contents are paged in by the OS as they
+//  are touched, so opening even a huge file costs next to nothing.
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// false if the file can't be opened or mapped (empty files can't be mapped either)
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return bytes != nullptr; }
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
@@ -31,16 +31,6 @@ void PointLight::draw() {
 	ofDrawSphere(position, 0.2);
 }
 
-int PointLight::getRaySamples(glm::vec3 p, glm::vec3 norm) {
-	// a point light only ever has one light ray at a time
-	samples.clear();
-
-	Ray r = Ray(p + norm * 0.01f, glm::normalize(position - p));
-	samples.push_back(r);
-	samplesPos.push_back(position);
-	return samples.size();
-}
-
 int AreaLight::ext = 0;
 
 void AreaLight::draw() {
@@ -126,43 +116,6 @@ bool AreaLight::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normalAtI
 	return insidePlane;
 }
 
-int AreaLight::getRaySamples(glm::vec3 p, glm::vec3 norm) {
-	samples.clear();
-	samplesPos.clear();
-
-	// grid dimensions relative to origin point (center)
-	float leftX = -width / 2;
-	float rightX = width / 2;
-	float topZ = -height / 2;
-	float botZ = height / 2;
-
-	// size & width of each cell
-	float cellWidth = width / nDivsWidth;
-	float cellHeight = height / nDivsHeight;
-
-	// for each cell in the grid, get nSamples random rays
-	for (int i = 0; i < nDivsWidth; i++) {
-		for (int j = 0; j < nDivsHeight; j++) {
-
-			// get dimensions of cell
-			float cellLeftX = leftX + (i * cellWidth);
-			float cellRightX = leftX + (i * cellWidth) + cellWidth;
-			float cellTopZ = topZ + (j * cellHeight);
-			float cellBotZ = topZ + (j * cellHeight) + cellHeight;
-
-			// get randomized point in cell as ray
-			for (int s = 0; s < nSamples; s++) {
-				glm::vec3 samplePos = glm::vec3(ofRandom(cellLeftX, cellRightX), 0, ofRandom(cellTopZ, cellBotZ)) + position;
-				Ray r = Ray(p + norm * 0.01f, glm::normalize(samplePos - p));
-				samples.push_back(r);
-				samplesPos.push_back(samplePos);
-			}
-		}
-	}
-
-	return samples.size();
-}
-
 int Sphere::ext = 0;
 
 void Sphere::draw() {
@@ -290,6 +243,38 @@ bool Plane::intersect(const Ray& ray, glm::vec3& point, glm::vec3& normalAtInter
 	return insidePlane;
 }
 
+// box around the part of the plane that intersect() accepts
+bool Plane::getBounds(Aabb& bounds) {
+	return getExtent(position, normal, width, height, bounds);
+}
+
+bool Plane::getExtent(const glm::vec3& position, const glm::vec3& normal, float width, float height, Aabb& bounds) {
+	glm::vec3 halfSize;
+	if (normal == glm::vec3(0, 1, 0) || normal == glm::vec3(0, -1, 0))
+		halfSize = glm::vec3(width / 2, 0, height / 2);
+	else if (normal == glm::vec3(0, 0, 1) || normal == glm::vec3(0, 0, -1))
+		halfSize = glm::vec3(width / 2, width / 2, 0);
+	else if (normal == glm::vec3(1, 0, 0) || normal == glm::vec3(-1, 0, 0))
+		halfSize = glm::vec3(0, width / 2, height / 2);
+	else
+		return false;
+
+	// pad the flat side a little so the box is never degenerate
+	halfSize = glm::max(halfSize, glm::vec3(0.001f));
+	bounds = Aabb();
+	bounds.grow(position - halfSize);
+	bounds.grow(position + halfSize);
+	return true;
+}
+
+// up direction of a plane rotated as in the constructor, (0, 1, 0) for a plane facing (0, 0, 1)
+glm::vec3 Plane::getUpDir(const glm::vec3& normal) {
+	if (normal == glm::vec3(0, 1, 0)) return glm::vec3(0, 0, -1);
+	if (normal == glm::vec3(0, -1, 0)) return glm::vec3(0, 0, 1);
+	if (normal == glm::vec3(0, 0, -1)) return glm::vec3(0, -1, 0);
+	return glm::vec3(0, 1, 0);
+}
+
 // get texture coordinates from point on plane
 void Plane::getTextureCoords(glm::vec3 p, float& u, float& v) {
 
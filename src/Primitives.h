@@ -5,11 +5,14 @@
 #include "glm/gtx/euler_angles.hpp"
 #include "glm/gtx/intersect.hpp"
 #include <glm/gtc/matrix_transform.hpp>
+#include "Bvh.h"
+#include "TextureCache.h"
 
 
 //  General Purpose Ray class 
 class Ray {
 public:
+	Ray() {}
 	Ray(glm::vec3 p, glm::vec3 d) { this->p = p; this->d = d; }
 	void draw(float t) { ofDrawLine(p, p + t * d); }
 
@@ -24,10 +27,13 @@ public:
 //  Base class for any renderable object in the scene
 class SceneObject {
 public:
+	virtual ~SceneObject() {}
+
 	// pure virtual funcs - must be overloaded
 	virtual void draw() = 0;
 	virtual bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) { cout << "SceneObject::intersect" << endl; return false; }
 	virtual glm::vec3 getNormal(const glm::vec3& p) { return glm::vec3(0, 0, 0); }
+	virtual bool getBounds(Aabb& bounds) { return false; }	// false if the object has no finite bounds
 	virtual void setupGUI() = 0;
 	virtual void updateGUI() = 0;
 	
@@ -50,8 +56,8 @@ public:
 	// texture objects & functions
 	void getTextureCoords(glm::vec3 p, float& u, float& v) {}
 	string textureName = "None";
-	ofImage diffuseMap;
-	ofImage specularMap;
+	TextureHandle diffuseMap;		// shared with every object using the same map, null if untextured
+	TextureHandle specularMap;
 	int numTiles = 1;
 };
 
@@ -71,12 +77,9 @@ public:
 	void draw() {}
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) { return false; }
 
-	// virtual functions - must be overloaded
-	virtual int getRaySamples(glm::vec3 p, glm::vec3 norm) = 0;
+	// lights are sampled by the renderer from a RenderLight copy (see Renderer.h)
 
 	float intensity;
-	vector<Ray> samples;
-	vector<glm::vec3> samplesPos;
 
 	ofParameter<float> lightIntensity;
 };
@@ -95,9 +98,6 @@ public:
 	
 	void draw() {}
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) { return false; }
-	int getRaySamples(glm::vec3 p, glm::vec3 norm) {
-		return 0;
-	}
 };
 
 
@@ -136,7 +136,6 @@ public:
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal) {
 		return (glm::intersectRaySphere(ray.p, ray.d, position, 0.2, point, normal));
 	}
-	int getRaySamples(glm::vec3 p, glm::vec3 norm);
 
 	static int PointLight::ext;
 };
@@ -197,7 +196,6 @@ public:
 
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
-	int getRaySamples(glm::vec3 p, glm::vec3 norm);
 
 	static int AreaLight::ext;
 
@@ -257,6 +255,12 @@ public:
 	glm::vec3 getNormal(const glm::vec3& p) {
 		return glm::normalize(glm::vec3(p - position));
 	}
+	bool getBounds(Aabb& bounds) {
+		bounds = Aabb();
+		bounds.grow(position - glm::vec3(radius));
+		bounds.grow(position + glm::vec3(radius));
+		return true;
+	}
 	void getTextureCoords(glm::vec3 p, float& u, float& v);
 
 	static int Sphere::ext; // keep track of # of spheres created
@@ -344,8 +348,14 @@ public:
 	void draw();
 	bool intersect(const Ray& ray, glm::vec3& point, glm::vec3& normal);
 	glm::vec3 getNormal(const glm::vec3& p) { return this->normal; }
+	bool getBounds(Aabb& bounds);
 	void getTextureCoords(glm::vec3 p, float& u, float& v);
 
+	// extent and texture up direction of a plane with the given normal, for
+	// planes that only exist as data (scene files)
+	static bool getExtent(const glm::vec3& position, const glm::vec3& normal, float width, float height, Aabb& bounds);
+	static glm::vec3 getUpDir(const glm::vec3& normal);
+
 	// listener functions for changing normal
 	void upNormal(bool& val);
 	void downNormal(bool& val);
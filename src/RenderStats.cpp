@@ -0,0 +1,64 @@
+#include "RenderStats.h"
+#include <cctype>
+#include <fstream>
+
+#if RT_STATS
+thread_local StatsThread statsThread;
+#endif
+
+
+void RenderStats::add(const RenderStats& s) {
+	for (int i = 0; i < NumCounters; i++) counters[i] += s.counters[i];
+	for (int i = 0; i < NumStages; i++) stageSeconds[i] += s.stageSeconds[i];
+}
+
+const char* RenderStats::getCounterName(Counter c) {
+	static const char* names[NumCounters] = {
+		"Primary Rays", "Shadow Rays", "Intersection Tests", "Texture Fetches", "Light Samples"
+	};
+	return names[c];
+}
+
+const char* RenderStats::getStageName(Stage s) {
+	static const char* names[NumStages] = {
+		"Ray Generation", "Traversal", "Shading", "Texture Lookup", "Image Save"
+	};
+	return names[s];
+}
+
+// keys are the names in snake case, e.g. "primary_rays"
+static std::string getJsonKey(const char* name) {
+	std::string key;
+	for (const char* c = name; *c; c++) key += (*c == ' ') ? '_' : (char)tolower(*c);
+	return key;
+}
+
+bool RenderStats::writeJson(const std::string& path) const {
+	std::ofstream out(path);
+	if (!out) return false;
+
+	out << "{\n";
+	out << "  \"render_seconds\": " << renderSeconds << ",\n";
+	out << "  \"denoise_seconds\": " << denoiseSeconds << ",\n";
+	out << "  \"counters\": {\n";
+	for (int i = 0; i < NumCounters; i++) {
+		out << "    \"" << getJsonKey(getCounterName((Counter)i)) << "\": " << counters[i]
+			<< ((i + 1 < NumCounters) ? ",\n" : "\n");
+	}
+	out << "  },\n";
+	out << "  \"stage_seconds\": {\n";
+	for (int i = 0; i < NumStages; i++) {
+		out << "    \"" << getJsonKey(getStageName((Stage)i)) << "\": " << stageSeconds[i]
+			<< ((i + 1 < NumStages) ? ",\n" : "\n");
+	}
+	out << "  }\n";
+	out << "}\n";
+	return bool(out);
+}
+
+void RenderStats::setThreadStats(RenderStats* stats) {
+#if RT_STATS
+	statsThread.stats = stats;
+	statsThread.stage = -1;
+#endif
+}
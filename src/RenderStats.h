@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+//  Counters and time per stage of a render.  The instrumentation is compiled
+//  in only when RT_STATS is 1, by default in debug builds, so release builds
+//  don't pay for it at all:
+//
+//    RT_STAT_COUNT(RenderStats::ShadowRays, 1);	// add to a counter
+//    RT_STAT_STAGE(RenderStats::Traversal);		// time the rest of the scope
+//
+//  Both go to the stats the calling thread has set with setThreadStats(),
+//  and do nothing on threads without stats.  Stage times are exclusive: a
+//  stage entered from another one pauses the outer stage until it is left.
+
+#ifndef RT_STATS
+#ifdef NDEBUG
+#define RT_STATS 0
+#else
+#define RT_STATS 1
+#endif
+#endif
+
+struct RenderStats {
+	enum Counter { PrimaryRays, ShadowRays, IntersectionTests, TextureFetches, LightSamples, NumCounters };
+	enum Stage { RayGeneration, Traversal, Shading, TextureLookup, ImageSave, NumStages };
+
+	uint64_t counters[NumCounters] = {};
+	double stageSeconds[NumStages] = {};	// summed over all threads
+	double renderSeconds = 0;				// wall time of the render
+	double denoiseSeconds = 0;				// wall time of denoising it, part of the above
+
+	void clear() { *this = RenderStats(); }
+	void add(const RenderStats& s);
+
+	static const char* getCounterName(Counter c);
+	static const char* getStageName(Stage s);
+
+	// false if the file can't be written
+	bool writeJson(const std::string& path) const;
+
+	// stats the instrumentation of the calling thread goes to, null for none
+	static void setThreadStats(RenderStats* stats);
+};
+
+
+#if RT_STATS
+
+// per-thread target of the macros, and the stage being timed
+struct StatsThread {
+	RenderStats* stats = nullptr;
+	int stage = -1;
+	std::chrono::steady_clock::time_point stageStart;
+};
+extern thread_local StatsThread statsThread;
+
+// times its scope as one stage, pausing the stage it was entered from
+class StatsStage {
+public:
+	StatsStage(RenderStats::Stage stage) {
+		if (!statsThread.stats) return;
+		parent = statsThread.stage;
+		switchTo(stage);
+	}
+	~StatsStage() {
+		if (statsThread.stats) switchTo(parent);
+	}
+
+private:
+	static void switchTo(int stage) {
+		auto now = std::chrono::steady_clock::now();
+		if (statsThread.stage >= 0) {
+			statsThread.stats->stageSeconds[statsThread.stage] +=
+				std::chrono::duration<double>(now - statsThread.stageStart).count();
+		}
+		statsThread.stage = stage;
+		statsThread.stageStart = now;
+	}
+
+	int parent = -1;
+};
+
+#define RT_STAT_COUNT(counter, n) \
+	do { if (statsThread.stats) statsThread.stats->counters[counter] += (n); } while (0)
+#define RT_STAT_CONCAT_(a, b) a##b
+#define RT_STAT_CONCAT(a, b) RT_STAT_CONCAT_(a, b)
+#define RT_STAT_STAGE(stage) StatsStage RT_STAT_CONCAT(statsStage, __LINE__)(stage)
+
+#else
+
+#define RT_STAT_COUNT(counter, n) do {} while (0)
+#define RT_STAT_STAGE(stage) do {} while (0)
+
+#endif
@@ -0,0 +1,861 @@
+#include "Renderer.h"
+#include <numeric>
+
+
+int RenderLight::getRaySamples(const glm::vec3& p, const glm::vec3& norm,
+	LightSample* samples, const Sampler& sampler, uint32_t dimension) const {
+	// a point light only ever has one light ray at a time,
+	// an area light gets nSamples random rays for each cell in the grid
+	int n = maxSamples();
+	for (int i = 0; i < n; i++) {
+		getRaySample(p, norm, i, samples[i], sampler, dimension);
+	}
+	return n;
+}
+
+// area light samples are numbered cell by cell (nSamples per cell), cells column by column
+void RenderLight::getRaySample(const glm::vec3& p, const glm::vec3& norm, int index,
+	LightSample& sample, const Sampler& sampler, uint32_t dimension) const {
+	if (type == Point) {
+		sample.ray = Ray(p + norm * 0.01f, glm::normalize(position - p));
+		sample.pos = position;
+		return;
+	}
+
+	int n = maxSamples();
+	int cell = index % n / nSamples;
+	int i = cell / nDivsHeight;
+	int j = cell % nDivsHeight;
+
+	// grid dimensions relative to origin point (center)
+	float leftX = -width / 2;
+	float topZ = -height / 2;
+
+	// get dimensions of cell
+	float cellLeftX = leftX + (i * cellWidth);
+	float cellRightX = leftX + (i * cellWidth) + cellWidth;
+	float cellTopZ = topZ + (j * cellHeight);
+	float cellBotZ = topZ + (j * cellHeight) + cellHeight;
+
+	// get jittered point in cell as ray, every cell steps through a pattern of its own
+	glm::vec2 jitter = sampler.get2D(index / n * nSamples + index % nSamples, Sampler::getDimension(dimension, cell));
+	float x = ofLerp(cellLeftX, cellRightX, jitter.x);
+	float z = ofLerp(cellTopZ, cellBotZ, jitter.y);
+	glm::vec3 samplePos = glm::vec3(x, 0, z) + position;
+	sample.ray = Ray(p + norm * 0.01f, glm::normalize(samplePos - p));
+	sample.pos = samplePos;
+}
+
+void RenderLight::compile() {
+	// size & width of each cell
+	cellWidth = width / nDivsWidth;
+	cellHeight = height / nDivsHeight;
+
+	// stride closest to n / golden ratio that visits every sample
+	int n = maxSamples();
+	sampleStride = std::max((int)(n * 0.618f + 0.5f), 1);
+	while (std::gcd(sampleStride, n) != 1) sampleStride++;
+}
+
+bool RenderLight::operator==(const RenderLight& l) const {
+	return type == l.type && position == l.position && intensity == l.intensity &&
+		width == l.width && height == l.height && nDivsWidth == l.nDivsWidth &&
+		nDivsHeight == l.nDivsHeight && nSamples == l.nSamples;
+}
+
+
+void RenderObject::compile() {
+	if (type == Sphere) {
+		// Sphere::getTextureCoords maps 2 pi radians to radius * 4 units
+		invRadius = 1 / radius;
+		angleScale = radius * 4 / (2 * PI) / numTiles;
+		textureScale = angleScale * invRadius;
+	}
+	else {
+		textureU = glm::normalize(glm::cross(normal, upDir)) / (float)numTiles;
+		textureV = glm::normalize(upDir) / (float)numTiles;
+		textureScale = 1.0f / numTiles;
+	}
+}
+
+// same mapping as Sphere::getTextureCoords / Plane::getTextureCoords
+void RenderObject::getTextureCoords(const glm::vec3& p, float& u, float& v) const {
+	glm::vec3 point = p - position;
+
+	if (type == Sphere) {
+		// project current point onto the sphere
+		float theta = asin(ofClamp(point.y * invRadius, -1, 1));
+		float phi = atan2(point.z, point.x);
+		u = phi * angleScale;
+		v = (theta + PI) * angleScale;
+	}
+	else {
+		// project current point onto the plane
+		u = glm::dot(point, textureU);
+		v = glm::dot(point, textureV);
+	}
+
+	// wrap to [0, 1), numTiles is already in the scales: more numTiles = less repetition
+	u = fmod(u, 1.0f);
+	v = fmod(v, 1.0f);
+	if (u < 0) u += 1.0f;
+	if (v < 0) v += 1.0f;
+}
+
+ofColor RenderObject::getDiffuse(float u, float v, float footprint) const {
+	return diffuseMap->getColor(u, v, footprint);
+}
+
+// the brightness of the specular map is the phong power, precomputed by the map
+float RenderObject::getSpecular(float u, float v, float footprint) const {
+	return specularMap->getValue(u, v, footprint);
+}
+
+bool RenderObject::operator==(const RenderObject& o) const {
+	return type == o.type && position == o.position && radius == o.radius &&
+		normal == o.normal && upDir == o.upDir && width == o.width && height == o.height &&
+		extent.min == o.extent.min && extent.max == o.extent.max &&
+		diffuseColor == o.diffuseColor && diffuseMap == o.diffuseMap &&
+		specularMap == o.specularMap && numTiles == o.numTiles;
+}
+
+
+void RenderScene::compile() {
+	for (auto& obj : objects) obj.compile();
+	for (auto& light : lights) light.compile();
+}
+
+
+RenderView RenderView::lookAt(const glm::vec3& position, const glm::vec3& target,
+	const glm::vec3& up, float fov, float aspect) {
+	glm::vec3 forward = glm::normalize(target - position);
+	glm::vec3 right = glm::normalize(glm::cross(forward, up));
+	glm::vec3 camUp = glm::cross(right, forward);
+
+	// view rectangle one unit in front of the camera
+	float halfHeight = tan(glm::radians(fov) / 2);
+	float halfWidth = halfHeight * aspect;
+
+	RenderView view;
+	view.origin = position;
+	view.corner = position + forward - right * halfWidth + camUp * halfHeight;
+	view.right = right * (2 * halfWidth);
+	view.down = -camUp * (2 * halfHeight);
+	return view;
+}
+
+
+bool RenderSettings::operator==(const RenderSettings& s) const {
+	return width == s.width && height == s.height && threads == s.threads &&
+		lambert == s.lambert && phong == s.phong && phongPower == s.phongPower &&
+		ambientIntensity == s.ambientIntensity && background == s.background &&
+		packetTracing == s.packetTracing && progressive == s.progressive && passes == s.passes &&
+		adaptiveShadows == s.adaptiveShadows && shadowTolerance == s.shadowTolerance &&
+		sampler == s.sampler && seed == s.seed &&
+		adaptiveAA == s.adaptiveAA && aaThreshold == s.aaThreshold && aaMaxSamples == s.aaMaxSamples &&
+		denoise == s.denoise && denoiseIterations == s.denoiseIterations && shadowRate == s.shadowRate;
+}
+
+
+void ShadowBuffers::allocate(int r, int imageWidth, int imageHeight, int lights) {
+	rate = r;
+	width = (imageWidth + rate - 1) / rate;
+	height = (imageHeight + rate - 1) / rate;
+	numLights = lights;
+	size_t n = (size_t)width * height;
+	normals.assign(n, glm::vec3(0));
+	depths.assign(n, 0);
+	ids.assign(n, -1);
+	visibility.assign(n * numLights, 0);
+}
+
+
+void Renderer::render(const RenderScene& s, ofPixels& image) {
+	cancel();
+	scene = s;
+	bCancel = false;
+	bFinished = false;
+	bRunning = true;
+	totalTiles = countTiles();
+	run();
+	image = completed;
+}
+
+void Renderer::start(const RenderScene& s) {
+	cancel();
+	scene = s;
+	bCancel = false;
+	bFinished = false;
+	bRunning = true;
+	totalTiles = countTiles();
+	thread = std::thread(&Renderer::run, this);
+}
+
+void Renderer::cancel() {
+	if (!thread.joinable()) return;
+
+	// tiles check the flag before they start, so this waits for at most one tile per thread
+	bCancel = true;
+	thread.join();
+	bRunning = false;
+}
+
+// tiles of one pass, counted before the render thread starts so getProgress()
+// doesn't read what beginRender() is writing
+int Renderer::countTiles() const {
+	const RenderSettings& settings = scene.settings;
+	int tiles = ((settings.width + tileSize - 1) / tileSize) * ((settings.height + tileSize - 1) / tileSize);
+	// low rate shadows and refining take another round of tiles each
+	return std::max(tiles, 1) * (1 + isLowRateShadows() + isAdaptiveAA());
+}
+
+float Renderer::getProgress() const {
+	int passes = scene.settings.progressive ? scene.settings.passes : 1;
+	int tiles = totalTiles;
+	if (bFinished) return 1;
+	return (passCount + std::min(tilesDone.load(), tiles) / (float)tiles) / std::max(passes, 1);
+}
+
+RenderStats Renderer::getStats() {
+	std::lock_guard<std::mutex> lock(imageMutex);
+	return stats;
+}
+
+void Renderer::getTileCosts(TileCosts& c) {
+	std::lock_guard<std::mutex> lock(imageMutex);
+	c = completedCosts;
+}
+
+bool Renderer::getImage(ofPixels& image, bool& bFinal) {
+	std::lock_guard<std::mutex> lock(imageMutex);
+	if (!bNewImage) return false;
+
+	image = completed;
+	bFinal = bFinalImage;
+	bNewImage = false;
+	return true;
+}
+
+void Renderer::prepare(const RenderScene& s) {
+	cancel();
+	scene = s;
+	beginRender();
+}
+
+// shades with the context of threads outside the pool, like the render thread
+ofColor Renderer::shadePoint(int object, const glm::vec3& point, const glm::vec3& normal) {
+	ShadingContext& ctx = contexts[pool.size()];
+	ctx.sampler.startPixel(0, 0);
+	return shade(scene.objects[object], point, normal, ctx);
+}
+
+// render thread (or the caller of render()): all passes, until done or cancelled
+void Renderer::run() {
+	passCount = 0;
+	tilesDone = 0;
+	beginRender();
+
+	int passes = scene.settings.progressive ? std::max(scene.settings.passes, 1) : 1;
+	while (!bCancel && passCount < passes) {
+		renderPass();
+		if (bCancel) break;	// pass is incomplete, keep showing the last one
+		passCount++;
+
+		// the denoised image is the one shown, passes go on adding to the noisy one
+		const ofPixels* image = &pixels;
+		if (scene.settings.denoise) {
+			auto start = std::chrono::steady_clock::now();
+			denoiser.denoise(pixels, aux, denoised, scene.settings.denoiseIterations, pool);
+			denoiseSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			image = &denoised;
+		}
+
+		std::lock_guard<std::mutex> lock(imageMutex);
+		completed = *image;
+		bNewImage = true;
+		bFinalImage = (passCount == passes);
+		updateStats();
+		completedCosts = costs;
+	}
+
+	if (!bCancel) bFinished = true;
+	bRunning = false;
+}
+
+// set up the pool, per-thread scratch data, image buffers and geometry for the scene
+void Renderer::beginRender() {
+	const RenderSettings& settings = scene.settings;
+	renderStart = std::chrono::steady_clock::now();
+
+	// precompute what shading needs of every object and light, once per render
+	scene.compile();
+
+	// restart the pool if the thread count was changed
+	if (settings.threads != poolThreads) {
+		pool.resize(settings.threads);
+		poolThreads = settings.threads;
+	}
+
+	// size every thread's light sample buffer for the largest light up front,
+	// so shading never allocates
+	int maxLightSamples = 0;
+	for (auto& light : scene.lights) maxLightSamples = std::max(maxLightSamples, light.maxSamples());
+	contexts.resize(pool.size() + 1);
+	for (int t = 0; t < contexts.size(); t++) {
+		if (contexts[t].lightSamples.size() < (size_t)maxLightSamples) {
+			contexts[t].lightSamples.resize(maxLightSamples);
+			contexts[t].visible.resize(maxLightSamples);
+		}
+		contexts[t].occluders.assign(scene.lights.size(), OccluderCache());
+		contexts[t].sampler.setup(settings.sampler, (uint32_t)settings.seed);
+		contexts[t].lightSample = -1;
+		contexts[t].upsampled.resize(scene.lights.size());
+		contexts[t].stats.clear();
+	}
+
+	pixels.allocate(settings.width, settings.height, OF_PIXELS_RGB);
+	aux.allocate(settings.width, settings.height);
+	if (isLowRateShadows()) shadows.allocate(settings.shadowRate, settings.width, settings.height, (int)scene.lights.size());
+	denoiseSeconds = 0;
+	if (settings.progressive) {
+		accumBuffer.allocate(settings.width, settings.height, 3);
+		accumBuffer.set(0);
+	}
+
+	// copy spheres and planes into the render geometry and build its bvhs (in parallel)
+	geometry.clear();
+	for (int id = 0; id < scene.objects.size(); id++) {
+		const RenderObject& obj = scene.objects[id];
+		if (obj.type == RenderObject::Sphere) geometry.addSphere(obj.position, obj.radius, id);
+		else geometry.addPlane(obj.position, obj.normal, obj.extent, id);
+	}
+	geometry.build(&pool);
+
+	pixelAngle = glm::length(scene.view.down) / settings.height;
+
+	tilesX = (settings.width + tileSize - 1) / tileSize;
+	tilesY = (settings.height + tileSize - 1) / tileSize;
+
+	costs.width = settings.width;
+	costs.height = settings.height;
+	costs.tileSize = tileSize;
+	costs.tilesX = tilesX;
+	costs.tilesY = tilesY;
+	costs.tiles.assign(tilesX * tilesY, TileCosts::Tile());
+}
+
+// sum up the stats of every thread, the pool is idle between passes
+void Renderer::updateStats() {
+	stats.clear();
+	for (auto& ctx : contexts) stats.add(ctx.stats);
+	stats.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+	stats.denoiseSeconds = denoiseSeconds;
+}
+
+void Renderer::renderPass() {
+	tilesDone = 0;
+	if (isLowRateShadows()) runTiles(&Renderer::renderShadowTile);
+	runTiles(&Renderer::renderTile);
+
+	// once every pixel has its center sample, supersample the ones that differ
+	// from their neighbors.  Neighbors are read from a copy of the centers, tiles
+	// next to each other are refined at the same time.
+	if (isAdaptiveAA() && !bCancel) {
+		centers = pixels;
+		runTiles(&Renderer::refineTile);
+	}
+}
+
+// run fn on every tile, spread over the pool, and add up their costs
+void Renderer::runTiles(void (Renderer::*fn)(int tile, ShadingContext& ctx)) {
+	pool.parallelFor(tilesX * tilesY, [this, fn](int tile) {
+		if (bCancel) return;
+		ShadingContext& ctx = contexts[pool.threadIndex()];
+		auto start = std::chrono::steady_clock::now();
+		int64_t rays = ctx.rays;
+
+		RenderStats::setThreadStats(&ctx.stats);
+		(this->*fn)(tile, ctx);
+		RenderStats::setThreadStats(nullptr);
+
+		costs.tiles[tile].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		costs.tiles[tile].rays += ctx.rays - rays;
+		tilesDone++;
+	});
+}
+
+// render every pixel of one tile, may run on any pool thread
+void Renderer::renderTile(int tile, ShadingContext& ctx) {
+	int startX = (tile % tilesX) * tileSize;
+	int startY = (tile / tilesX) * tileSize;
+	int endX = std::min(startX + tileSize, scene.settings.width);
+	int endY = std::min(startY + tileSize, scene.settings.height);
+
+	if (scene.settings.progressive) {
+		renderTileProgressive(startX, startY, endX, endY, ctx);
+		return;
+	}
+
+	if (scene.settings.packetTracing) {
+		for (int y = startY; y < endY; y += packetWidth) {
+			for (int x = startX; x < endX; x += packetWidth) {
+				renderPacket(x, y, std::min(x + packetWidth, endX), std::min(y + packetWidth, endY), ctx);
+			}
+		}
+		return;
+	}
+
+	for (int j = startY; j < endY; j++) {
+		for (int i = startX; i < endX; i++) {
+			// shoot ray through the pixel center
+			ctx.sampler.startPixel(i, j);
+			ctx.auxPixel = j * scene.settings.width + i;
+			ctx.shadowPixel = ctx.auxPixel;
+			Ray ray = getPrimaryRay(i + 0.5, j + 0.5);
+			pixels.setColor(i, j, traceRay(ray, ctx));
+		}
+	}
+	ctx.auxPixel = -1;
+	ctx.shadowPixel = -1;
+}
+
+// add one sample per pixel of a tile to the accumulation buffer and show the average.
+// The first pass goes through pixel centers, later ones are jittered for anti-aliasing.
+void Renderer::renderTileProgressive(int startX, int startY, int endX, int endY, ShadingContext& ctx) {
+	float* accum = accumBuffer.getData();
+	float weight = 1.0f / (passCount + 1);
+	int width = scene.settings.width;
+
+	for (int j = startY; j < endY; j++) {
+		for (int i = startX; i < endX; i++) {
+			ctx.sampler.startPixel(i, j);
+			glm::vec2 offset(0.5, 0.5);
+			if (passCount > 0) offset = ctx.sampler.get2D(passCount - 1, jitterDimension);
+
+			// step through the light samples, offset per pixel so neighbors
+			// don't all see the same sample in the same pass
+			ctx.lightSample = passCount + (int)(((unsigned)i * 73856093u ^ (unsigned)j * 19349663u) & 0xffff);
+			ctx.auxPixel = (passCount == 0) ? j * width + i : -1;
+			ofColor color = traceRay(getPrimaryRay(i + offset.x, j + offset.y), ctx);
+			ctx.lightSample = -1;
+			ctx.auxPixel = -1;
+
+			float* sum = accum + ((size_t)j * width + i) * 3;
+			sum[0] += color.r;
+			sum[1] += color.g;
+			sum[2] += color.b;
+			pixels.setColor(i, j, ofColor(sum[0] * weight, sum[1] * weight, sum[2] * weight));
+		}
+	}
+}
+
+// brightness of a color in [0, 1]
+static float getLuma(const ofColor& c) {
+	return (0.299f * c.r + 0.587f * c.g + 0.114f * c.b) / 255;
+}
+
+// adaptive anti-aliasing: supersample the pixels of a tile whose 3x3 neighborhood
+// of centers differs by more than the threshold.  Jittered samples are added aaBatch
+// at a time until the standard error of their mean is well under the threshold, or
+// the pixel has aaMaxSamples.  The pixel becomes their mean.
+void Renderer::refineTile(int tile, ShadingContext& ctx) {
+	const RenderSettings& settings = scene.settings;
+	int startX = (tile % tilesX) * tileSize;
+	int startY = (tile / tilesX) * tileSize;
+	int endX = std::min(startX + tileSize, settings.width);
+	int endY = std::min(startY + tileSize, settings.height);
+
+	for (int j = startY; j < endY; j++) {
+		for (int i = startX; i < endX; i++) {
+			float lo = 1, hi = 0;
+			for (int y = std::max(j - 1, 0); y <= std::min(j + 1, settings.height - 1); y++) {
+				for (int x = std::max(i - 1, 0); x <= std::min(i + 1, settings.width - 1); x++) {
+					float luma = getLuma(centers.getColor(x, y));
+					lo = std::min(lo, luma);
+					hi = std::max(hi, luma);
+				}
+			}
+			if (hi - lo <= settings.aaThreshold) continue;
+
+			ctx.sampler.startPixel(i, j);
+			glm::vec3 sum(0);
+			float lumaSum = 0, lumaSquares = 0;
+			int count = 0;
+			while (count < settings.aaMaxSamples) {
+				int end = std::min(count + aaBatch, settings.aaMaxSamples);
+				for (; count < end; count++) {
+					glm::vec2 offset = ctx.sampler.get2D(count, jitterDimension);
+					ofColor color = traceRay(getPrimaryRay(i + offset.x, j + offset.y), ctx);
+					sum += glm::vec3(color.r, color.g, color.b);
+					float luma = getLuma(color);
+					lumaSum += luma;
+					lumaSquares += luma * luma;
+				}
+				float mean = lumaSum / count;
+				float variance = std::max(lumaSquares / count - mean * mean, 0.0f);
+				if (sqrt(variance / count) <= settings.aaThreshold / 4) break;
+			}
+			sum /= count;
+			pixels.setColor(i, j, ofColor(sum.x, sum.y, sum.z));
+		}
+	}
+}
+
+// low rate shadows: trace the center of every block of the tile (blocks belong to
+// the tile their first pixel is in) and the visible fraction of every area light
+// there.  Points the pixels of the pass see are lit by it, upsampled.
+void Renderer::renderShadowTile(int tile, ShadingContext& ctx) {
+	const RenderSettings& settings = scene.settings;
+	int rate = shadows.rate;
+	int startX = (tile % tilesX) * tileSize;
+	int startY = (tile / tilesX) * tileSize;
+	int endX = std::min(startX + tileSize, settings.width);
+	int endY = std::min(startY + tileSize, settings.height);
+
+	for (int by = (startY + rate - 1) / rate; by * rate < endY; by++) {
+		for (int bx = (startX + rate - 1) / rate; bx * rate < endX; bx++) {
+			float x = (bx * rate + std::min(bx * rate + rate, settings.width)) * 0.5f;
+			float y = (by * rate + std::min(by * rate + rate, settings.height)) * 0.5f;
+			ctx.sampler.startPixel((int)x, (int)y);
+			Ray ray = getPrimaryRay(x, y);
+
+			GeometryHit hit;
+			bool bHit;
+			ctx.rays++;
+			{
+				RT_STAT_STAGE(RenderStats::Traversal);
+				bHit = geometry.intersect(ray.p, ray.d, hit);
+			}
+			size_t block = (size_t)by * shadows.width + bx;
+			if (!bHit) continue;
+
+			shadows.normals[block] = hit.normal;
+			shadows.depths[block] = glm::length(hit.point - scene.view.origin);
+			shadows.ids[block] = hit.id;
+			float* visibility = &shadows.visibility[block * shadows.numLights];
+			for (int l = 0; l < scene.lights.size(); l++) {
+				const RenderLight& light = scene.lights[l];
+				if (light.type != RenderLight::Area || light.intensity <= 0) continue;
+				int numRays = sampleLight(l, hit.point, hit.normal, ctx);
+				float sum = 0;
+				for (int i = 0; i < numRays; i++) sum += ctx.visible[i];
+				visibility[l] = sum / numRays;
+			}
+		}
+	}
+}
+
+// allowed difference in depth between a point and the shadow samples it is lit by,
+// relative to its depth, per block of distance
+static const float shadowDepthTolerance = 0.05;
+
+// visible fraction of every area light at a point the pixel sees, from the 4 shadow
+// samples around it: weighted bilinearly, and by how closely they match the point
+// (same object, facing the same way, at about the same depth), i.e. joint bilateral
+// upsampling.  False if none of them match, the point has to trace its shadows.
+bool Renderer::upsampleShadows(int pixel, const glm::vec3& point, const glm::vec3& normal, int id, float* visibility) const {
+	int rate = shadows.rate;
+	int x = pixel % scene.settings.width;
+	int y = pixel / scene.settings.width;
+	float fx = (x + 0.5f) / rate - 0.5f;
+	float fy = (y + 0.5f) / rate - 0.5f;
+	int x0 = (int)floor(fx), y0 = (int)floor(fy);
+	float tx = fx - x0, ty = fy - y0;
+	float depth = glm::length(point - scene.view.origin);
+	float depthScale = 1 / (shadowDepthTolerance * depth * rate);
+
+	size_t blocks[4];
+	float weights[4], total = 0;
+	for (int k = 0; k < 4; k++) {
+		int bx = ofClamp(x0 + (k & 1), 0, shadows.width - 1);
+		int by = ofClamp(y0 + (k >> 1), 0, shadows.height - 1);
+		blocks[k] = (size_t)by * shadows.width + bx;
+		weights[k] = 0;
+		if (shadows.ids[blocks[k]] != id) continue;
+
+		// bilinear, but never quite 0 so the other blocks can stand in for one that doesn't match
+		float w = std::max(((k & 1) ? tx : 1 - tx) * ((k >> 1) ? ty : 1 - ty), 0.05f);
+		float cosAngle = std::max(glm::dot(normal, shadows.normals[blocks[k]]), 0.0f);
+		for (int i = 0; i < 5; i++) cosAngle *= cosAngle;	// ^32
+		w *= cosAngle * exp(-fabs(depth - shadows.depths[blocks[k]]) * depthScale);
+		weights[k] = w;
+		total += w;
+	}
+	if (total < 1e-4f) return false;
+
+	for (int l = 0; l < shadows.numLights; l++) {
+		float sum = 0;
+		for (int k = 0; k < 4; k++) sum += weights[k] * shadows.visibility[blocks[k] * shadows.numLights + l];
+		visibility[l] = sum / total;
+	}
+	return true;
+}
+
+// trace the primary rays of a block of pixels together as one packet,
+// then shade every pixel on its own
+void Renderer::renderPacket(int startX, int startY, int endX, int endY, ShadingContext& ctx) {
+	RayPacket packet;
+	for (int j = startY; j < endY; j++) {
+		for (int i = startX; i < endX; i++) {
+			Ray ray = getPrimaryRay(i + 0.5, j + 0.5);
+			packet.set(packet.count++, ray.p, ray.d);
+		}
+	}
+
+	GeometryHit hits[RayPacket::maxRays];
+	bool bHit[RayPacket::maxRays];
+	ctx.rays += packet.count;
+	{
+		RT_STAT_STAGE(RenderStats::Traversal);
+		geometry.intersectPacket(packet, hits, bHit);
+	}
+
+	int k = 0;
+	for (int j = startY; j < endY; j++) {
+		for (int i = startX; i < endX; i++, k++) {
+			ctx.sampler.startPixel(i, j);
+			ctx.auxPixel = j * scene.settings.width + i;
+			ctx.shadowPixel = ctx.auxPixel;
+			if (bHit[k]) pixels.setColor(i, j, shade(scene.objects[hits[k].id], hits[k].point, hits[k].normal, ctx));
+			else pixels.setColor(i, j, scene.settings.background);
+		}
+	}
+	ctx.auxPixel = -1;
+	ctx.shadowPixel = -1;
+}
+
+// ray from the view origin through image position (x, y) in pixels
+Ray Renderer::getPrimaryRay(float x, float y) const {
+	RT_STAT_STAGE(RenderStats::RayGeneration);
+	RT_STAT_COUNT(RenderStats::PrimaryRays, 1);
+	const RenderView& view = scene.view;
+	glm::vec3 pointOnView = view.corner + (x / scene.settings.width) * view.right + (y / scene.settings.height) * view.down;
+	return Ray(view.origin, glm::normalize(pointOnView - view.origin));
+}
+
+// find the closest object along the ray and shade it
+ofColor Renderer::traceRay(const Ray& ray, ShadingContext& ctx) {
+	GeometryHit hit;
+	bool bHit;
+	ctx.rays++;
+	{
+		RT_STAT_STAGE(RenderStats::Traversal);
+		bHit = geometry.intersect(ray.p, ray.d, hit);
+	}
+
+	// default to background color if no object
+	if (!bHit) return scene.settings.background;
+
+	return shade(scene.objects[hit.id], hit.point, hit.normal, ctx);
+}
+
+// color of a hit point, with the selected shading and the object's textures
+ofColor Renderer::shade(const RenderObject& obj, const glm::vec3& closestPoint,
+	const glm::vec3& normalAtIntersect, ShadingContext& ctx) {
+	RT_STAT_STAGE(RenderStats::Shading);
+
+	// default values if object has no texture/shading type not selected
+	ofColor color = obj.diffuseColor;
+	float specular = scene.settings.phongPower;
+
+	if (obj.diffuseMap && obj.specularMap) {
+		RT_STAT_STAGE(RenderStats::TextureLookup);
+		RT_STAT_COUNT(RenderStats::TextureFetches, 2);
+
+		// texture coordinates depend on object type
+		float texU, texV;
+		obj.getTextureCoords(closestPoint, texU, texV);
+
+		// footprint of the pixel on the surface: its cone from the camera,
+		// stretched by the angle the surface is seen at.  Filtering follows the
+		// long side of the footprint, so grazing surfaces blur rather than alias.
+		glm::vec3 toPoint = closestPoint - scene.view.origin;
+		float distance = glm::length(toPoint);
+		float cosAngle = glm::max(glm::abs(glm::dot(toPoint, normalAtIntersect)) / distance, 0.05f);
+		float footprint = distance * pixelAngle / cosAngle * obj.getTextureScale();
+
+		// get texture color from diffuse map, specular coefficient from specular map
+		color = obj.getDiffuse(texU, texV, footprint);
+		specular = obj.getSpecular(texU, texV, footprint);
+	}
+
+	if (ctx.auxPixel >= 0) {
+		int i = ctx.auxPixel;
+		aux.normals[i] = normalAtIntersect;
+		aux.depths[i] = glm::length(closestPoint - scene.view.origin);
+		aux.albedos[i] = glm::vec3(color.r, color.g, color.b) / 255.0f;
+		aux.ids[i] = (int)(&obj - scene.objects.data());
+	}
+
+	// low rate shadows: area lights are as visible as the shadow samples around the pixel say
+	if (ctx.shadowPixel >= 0 && isLowRateShadows() && (scene.settings.lambert || scene.settings.phong)) {
+		ctx.bUpsampled = upsampleShadows(ctx.shadowPixel, closestPoint, normalAtIntersect,
+			(int)(&obj - scene.objects.data()), ctx.upsampled.data());
+	}
+
+	if (scene.settings.lambert) color = lambert(closestPoint, normalAtIntersect, color, ctx);
+	if (scene.settings.phong) color = phong(closestPoint, normalAtIntersect, color, ofColor::lightYellow, specular, ctx);
+	ctx.bUpsampled = false;
+	return color;
+}
+
+// check if any object in the scene intersects the ray between the light and point,
+// objects past the light sample do not count
+bool Renderer::inShadow(const LightSample& sample, OccluderCache& occluder) const {
+	RT_STAT_STAGE(RenderStats::Traversal);
+	RT_STAT_COUNT(RenderStats::ShadowRays, 1);
+	float lightDistance = glm::length(sample.pos - sample.ray.p);
+	return geometry.occluded(sample.ray.p, sample.ray.d, 0, lightDistance, &occluder);
+}
+
+// fill ctx.lightSamples with samples of light l for point p and ctx.visible with
+// their weights (0 where they don't reach it), returns how many to average over.
+// Progressive passes only take sample ctx.lightSample (going round the light's
+// samples).
+//
+// With adaptive shadows, an area light's samples are traced in getSampleIndex()
+// order, shadowBatch at a time.  If the first batch agrees, the point is fully lit
+// or fully in shadow and the rest are taken to agree without tracing them (lit
+// points still shade with every sample, so they look the same as without).  In
+// penumbrae, batches are added until the standard error of the visible fraction
+// is within the tolerance, and weighted to stand in for the samples not traced.
+int Renderer::sampleLight(int l, const glm::vec3& p, const glm::vec3& norm, ShadingContext& ctx) {
+	const RenderLight& light = scene.lights[l];
+	LightSample* samples = ctx.lightSamples.data();
+	float* visible = ctx.visible.data();
+	int n = light.maxSamples();
+
+	if (ctx.lightSample >= 0 && n > 1) {
+		RT_STAT_COUNT(RenderStats::LightSamples, 1);
+		light.getRaySample(p, norm, ctx.lightSample, samples[0], ctx.sampler, 1 + l);
+		visible[0] = inShadow(samples[0], ctx.occluders[l]) ? 0 : 1;
+		ctx.rays++;
+		return 1;
+	}
+
+	// low rate shadows: no shadow rays, every sample lit by the upsampled visible fraction
+	if (ctx.bUpsampled && light.type == RenderLight::Area) {
+		float fraction = ctx.upsampled[l];
+		if (fraction > 0) {
+			RT_STAT_COUNT(RenderStats::LightSamples, n);
+			light.getRaySamples(p, norm, samples, ctx.sampler, 1 + l);
+		}
+		std::fill(visible, visible + n, fraction);
+		return n;
+	}
+
+	if (!scene.settings.adaptiveShadows || n <= 2 * shadowBatch) {
+		RT_STAT_COUNT(RenderStats::LightSamples, n);
+		light.getRaySamples(p, norm, samples, ctx.sampler, 1 + l);
+		for (int i = 0; i < n; i++) visible[i] = inShadow(samples[i], ctx.occluders[l]) ? 0 : 1;
+		ctx.rays += n;
+		return n;
+	}
+
+	int traced = 0, hits = 0;
+	while (traced < n) {
+		int end = std::min(traced + shadowBatch, n);
+		for (int k = traced; k < end; k++) {
+			light.getRaySample(p, norm, light.getSampleIndex(k), samples[k], ctx.sampler, 1 + l);
+			bool bVisible = !inShadow(samples[k], ctx.occluders[l]);
+			visible[k] = bVisible ? 1 : 0;
+			hits += bVisible;
+		}
+		ctx.rays += end - traced;
+		traced = end;
+
+		if (traced == shadowBatch && (hits == 0 || hits == traced)) break;
+		float fraction = hits / (float)traced;
+		if (sqrt(fraction * (1 - fraction) / traced) <= scene.settings.shadowTolerance) break;
+	}
+	RT_STAT_COUNT(RenderStats::LightSamples, traced);
+
+	// fully lit: the remaining samples only shade, no shadow rays
+	if (traced == shadowBatch && hits == traced) {
+		for (int k = traced; k < n; k++) {
+			light.getRaySample(p, norm, light.getSampleIndex(k), samples[k], ctx.sampler, 1 + l);
+			visible[k] = 1;
+		}
+		return n;
+	}
+
+	// otherwise the traced samples stand in for the rest
+	float weight = n / (float)traced;
+	for (int k = 0; k < traced; k++) visible[k] *= weight;
+	std::fill(visible + traced, visible + n, 0.0f);
+	return n;
+}
+
+// lambert shading
+ofColor Renderer::lambert(const glm::vec3& p, const glm::vec3& norm,
+	const ofColor diffuse, ShadingContext& ctx) {
+
+	ofColor result = scene.settings.ambientIntensity * diffuse;
+	float totalDiffuse = 0;
+	LightSample* samples = ctx.lightSamples.data();
+
+	for (int l = 0; l < scene.lights.size(); l++) {
+		const RenderLight& light = scene.lights[l];
+		if (light.intensity <= 0) continue; // skip lights with no "light"
+
+		int numRays = sampleLight(l, p, norm, ctx); // get ray(s) from light
+		for (int i = 0; i < numRays; i++) {
+			if (ctx.visible[i] > 0) {
+
+				// calculate intensity of light with respect to distance
+				float distance = glm::length(samples[i].pos - p);
+				float illumination = ctx.visible[i] * light.intensity / (distance * distance);
+
+				// lambert formula
+				glm::vec3 lightDirection = samples[i].ray.d;
+				float lambertCalc = glm::max(glm::dot(norm, lightDirection), 0.0f);
+
+				totalDiffuse += lambertCalc * illumination;
+			}
+		}
+		result += diffuse * (totalDiffuse / numRays);
+	}
+
+	return result;
+}
+
+// phong shading (lambert + specular)
+ofColor Renderer::phong(const glm::vec3& p, const glm::vec3& norm,
+	const ofColor diffuse, const ofColor specular, float power, ShadingContext& ctx) {
+
+	ofColor result = scene.settings.ambientIntensity * diffuse;
+	float totalDiffuse = 0;
+	float totalSpecular = 0;
+	LightSample* samples = ctx.lightSamples.data();
+
+	for (int l = 0; l < scene.lights.size(); l++) {
+		const RenderLight& light = scene.lights[l];
+		if (light.intensity <= 0) continue; // skip lights with no "light"
+
+		int numRays = sampleLight(l, p, norm, ctx); // get ray(s) from light
+		for (int i = 0; i < numRays; i++) {
+
+			if (ctx.visible[i] > 0) {
+
+				// calculate intensity of light with respect to distance
+				float distance = glm::length(samples[i].pos - p);
+				float illumination = ctx.visible[i] * light.intensity / (distance * distance);
+
+				// lambert formula
+				glm::vec3 lightDirection = samples[i].ray.d;
+				float lambertCalc = glm::max(glm::dot(norm, lightDirection), 0.0f);
+
+				// specular formula
+				glm::vec3 viewDirection = glm::normalize(scene.view.origin - p);
+				glm::vec3 h = glm::normalize(viewDirection + lightDirection);
+				float specularCalc = glm::pow(glm::max(glm::dot(norm, h), 0.0f), power);
+
+				totalDiffuse += lambertCalc * illumination;
+				totalSpecular += specularCalc * illumination;
+			}
+		}
+		result += (diffuse * (totalDiffuse / numRays)) + (specular * (totalSpecular / numRays));
+	}
+
+	return result;
+}
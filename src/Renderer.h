@@ -0,0 +1,307 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Denoiser.h"
+#include "Primitives.h"
+#include "RenderStats.h"
+#include "Sampler.h"
+#include "SceneGeometry.h"
+#include "TextureMap.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+// one sample of a light as seen from a shaded point
+struct LightSample {
+	Ray ray;			// shadow ray from the point towards the light
+	glm::vec3 pos;		// sampled position on the light
+};
+
+
+//  Light as seen by the renderer, copied out of the scene's Light objects.
+//  Sampling never modifies the light, so any number of threads can share one.
+struct RenderLight {
+	enum Type { Point, Area };
+	Type type = Point;
+	glm::vec3 position;
+	float intensity = 0;
+
+	// area lights: width x height grid centered on position (facing down),
+	// nSamples jittered samples per cell
+	float width = 0, height = 0;
+	int nDivsWidth = 1, nDivsHeight = 1, nSamples = 1;
+
+	// derived from the above by compile(), which the renderer calls on its copy
+	float cellWidth = 0, cellHeight = 0;
+	int sampleStride = 1;	// coprime to maxSamples(), see getSampleIndex()
+	void compile();
+
+	// index of the k-th sample in an order that spreads any first few of them over
+	// the whole light (a golden ratio stride through the cells), for adaptive sampling
+	int getSampleIndex(int k) const { return (int)((int64_t)k * sampleStride % maxSamples()); }
+
+	int maxSamples() const { return (type == Area) ? nDivsWidth * nDivsHeight * nSamples : 1; }
+
+	// write the light's samples for point p into samples (room for maxSamples()
+	// entries), returns how many were written.  Area light samples are jittered
+	// within their cells by sampler's pattern dimension (and the cell).
+	int getRaySamples(const glm::vec3& p, const glm::vec3& norm,
+		LightSample* samples, const Sampler& sampler, uint32_t dimension) const;
+
+	// just sample number index of the above, for renders that spread the light's
+	// samples over several passes.  Numbers past maxSamples() go round the cells
+	// again, with new jitter.
+	void getRaySample(const glm::vec3& p, const glm::vec3& norm, int index,
+		LightSample& sample, const Sampler& sampler, uint32_t dimension) const;
+
+	bool operator==(const RenderLight& l) const;
+};
+
+
+//  Sphere or plane as seen by the renderer
+struct RenderObject {
+	enum Type { Sphere, Plane };
+	Type type = Sphere;
+	glm::vec3 position;
+	float radius = 1;				// sphere
+	glm::vec3 normal, upDir;		// plane, upDir orients the texture
+	float width = 0, height = 0;	// plane
+	Aabb extent;					// plane, from its size (Plane::getExtent)
+
+	// material.  Textures are not owned, the app stops the render before changing them.
+	ofColor diffuseColor;
+	const TextureMap* diffuseMap = nullptr;		// Color format, null if untextured
+	const TextureMap* specularMap = nullptr;	// Specular format
+	int numTiles = 1;
+
+	// derived from the above by compile(), which the renderer calls on its copy,
+	// so shading doesn't have to work them out for every hit
+	glm::vec3 textureU, textureV;	// plane: texture axes, over numTiles
+	float invRadius = 1;			// sphere
+	float angleScale = 1;			// sphere: texture units per radian
+	float textureScale = 1;			// texture units per world unit
+	void compile();
+
+	// compiled objects only
+	void getTextureCoords(const glm::vec3& p, float& u, float& v) const;
+	// texture units per world unit along the surface (at a sphere's equator)
+	float getTextureScale() const { return textureScale; }
+	// filtered texture lookups at (u, v) in [0, 1) over a footprint in texture
+	// units (see TextureMap::sample), textured objects only
+	ofColor getDiffuse(float u, float v, float footprint) const;
+	float getSpecular(float u, float v, float footprint) const;
+
+	bool operator==(const RenderObject& o) const;
+};
+
+
+// primary rays go from origin through corner + x * right + y * down, (x, y) in [0, 1]
+struct RenderView {
+	glm::vec3 origin, corner, right, down;
+
+	// pinhole camera at position looking at target, fov is the vertical field of
+	// view in degrees and aspect = width / height.  Needs no window, unlike ofCamera.
+	static RenderView lookAt(const glm::vec3& position, const glm::vec3& target,
+		const glm::vec3& up, float fov, float aspect);
+
+	bool operator==(const RenderView& v) const {
+		return origin == v.origin && corner == v.corner && right == v.right && down == v.down;
+	}
+};
+
+
+struct RenderSettings {
+	int width = 1200;
+	int height = 800;
+	int threads = 0;				// 0 = all cores
+	bool lambert = false;
+	bool phong = false;
+	float phongPower = 10;
+	float ambientIntensity = 0.1;
+	ofColor background = ofColor::gray;
+	bool packetTracing = false;		// trace primary rays in 8x8 packets
+	bool progressive = false;		// render passes one jittered sample per pixel at a time
+	int passes = 1;					// number of progressive passes
+	bool adaptiveShadows = true;	// stop tracing an area light's shadow rays once the answer is clear
+	float shadowTolerance = 0.05;	// adaptive: allowed standard error of the visible fraction
+	Sampler::Type sampler = Sampler::Sobol;	// pattern of pixel jitter and light samples
+	int seed = 0;					// renders with the same seed come out the same
+	bool adaptiveAA = false;		// supersample pixels that differ from their neighbors (not progressive)
+	float aaThreshold = 0.1;		// adaptive: difference in brightness, in [0, 1], that gets supersampled
+	int aaMaxSamples = 16;			// adaptive: most samples per pixel
+	bool denoise = false;			// filter the noise of area light samples out of every pass shown
+	int denoiseIterations = 5;		// wider filter with every one, 5 covers 61 x 61 pixels
+	int shadowRate = 1;				// trace area light shadows once per shadowRate x shadowRate pixels (not progressive)
+
+	bool operator==(const RenderSettings& s) const;
+};
+
+
+//  Everything a render needs, copied from the app so the scene can be edited
+//  while the copy is being rendered
+struct RenderScene {
+	vector<RenderObject> objects;
+	vector<RenderLight> lights;
+	RenderView view;
+	RenderSettings settings;
+
+	// work out everything derived of the objects and lights
+	void compile();
+
+	// derived data isn't compared, it follows from the rest
+	bool operator==(const RenderScene& s) const {
+		return objects == s.objects && lights == s.lights && view == s.view && settings == s.settings;
+	}
+	bool operator!=(const RenderScene& s) const { return !(*this == s); }
+};
+
+
+// where the time of a render went: wall time and rays of every tile
+struct TileCosts {
+	struct Tile {
+		double seconds = 0;
+		int64_t rays = 0;	// primary and shadow rays
+	};
+	int width = 0, height = 0;		// of the image
+	int tileSize = 0, tilesX = 0, tilesY = 0;
+	vector<Tile> tiles;				// row by row, summed over all passes
+};
+
+
+// area light visibility traced at a lower rate than the image: at the center of
+// every rate x rate block of pixels, with what was hit there to upsample it by
+struct ShadowBuffers {
+	int rate = 1, width = 0, height = 0, numLights = 0;
+	vector<glm::vec3> normals;
+	vector<float> depths;		// distance from the camera
+	vector<int> ids;			// index of the object, -1 where nothing was hit
+	vector<float> visibility;	// numLights per block: visible fraction of every area light
+
+	void allocate(int rate, int imageWidth, int imageHeight, int numLights);
+};
+
+
+// per-thread scratch data for shading, reused for every pixel a thread renders
+struct ShadingContext {
+	vector<LightSample> lightSamples;
+	vector<float> visible;				// weight of every light sample, 0 where it doesn't reach the point
+	vector<OccluderCache> occluders;	// last shadow ray occluder of every light
+	Sampler sampler;		// started at the pixel being rendered
+	int lightSample = -1;	// >= 0: shade with just this sample of every light (progressive passes)
+	int auxPixel = -1;		// >= 0: record what is shaded in the aux buffers, at this pixel
+	int shadowPixel = -1;	// >= 0: low rate shadows, upsample the visibility of this pixel
+	vector<float> upsampled;	// low rate shadows: visible fraction of every light at the point being shaded
+	bool bUpsampled = false;	// upsampled holds it
+	RenderStats stats;		// of this thread, for the whole render
+	int64_t rays = 0;		// rays traced by this thread, for the tile costs
+};
+
+
+//  Ray tracer for a RenderScene.  The image is rendered in tiles spread over a
+//  thread pool, either on the calling thread (render()) or on a background
+//  thread (start()) that can be cancelled at any tile.
+class Renderer {
+public:
+	~Renderer() { cancel(); }
+
+	// render all passes of the scene and wait for them
+	void render(const RenderScene& scene, ofPixels& pixels);
+
+	// render in the background, cancelling the render in flight (if any)
+	void start(const RenderScene& scene);
+	// stop the background render, returns once the render thread has stopped
+	void cancel();
+
+	bool isRunning() const { return bRunning; }
+	bool isFinished() const { return bFinished; }	// all passes done
+	float getProgress() const;						// in [0, 1]
+	int getPass() const { return passCount; }		// completed passes
+	const RenderScene& getScene() const { return scene; }
+
+	// copy the image of the last completed pass, if there is a new one since the
+	// last call.  bFinal is set if it is the final image.
+	bool getImage(ofPixels& image, bool& bFinal);
+	// stats up to the last completed pass (counters and stage times need RT_STATS)
+	RenderStats getStats();
+	// cost of every tile up to the last completed pass
+	void getTileCosts(TileCosts& costs);
+	// what the pixel centers of the last render hit, once its first pass is
+	// complete.  Not while a render is running.
+	const AuxBuffers& getAuxBuffers() const { return aux; }
+
+	// set up everything a render of the scene needs without rendering it, then
+	// shade single hit points of it on the calling thread (for benchmarks)
+	void prepare(const RenderScene& scene);
+	ofColor shadePoint(int object, const glm::vec3& point, const glm::vec3& normal);
+
+private:
+	void run();
+	void beginRender();
+	void renderPass();
+	int countTiles() const;
+	void updateStats();
+	void runTiles(void (Renderer::*fn)(int tile, ShadingContext& ctx));
+	void renderTile(int tile, ShadingContext& ctx);
+	void refineTile(int tile, ShadingContext& ctx);
+	void renderShadowTile(int tile, ShadingContext& ctx);
+	bool isAdaptiveAA() const { return scene.settings.adaptiveAA && !scene.settings.progressive; }
+	bool isLowRateShadows() const { return scene.settings.shadowRate > 1 && !scene.settings.progressive; }
+	bool upsampleShadows(int pixel, const glm::vec3& point, const glm::vec3& normal, int id, float* visibility) const;
+	void renderTileProgressive(int startX, int startY, int endX, int endY, ShadingContext& ctx);
+	void renderPacket(int startX, int startY, int endX, int endY, ShadingContext& ctx);
+	Ray getPrimaryRay(float x, float y) const;
+
+	ofColor traceRay(const Ray& ray, ShadingContext& ctx);
+	ofColor shade(const RenderObject& obj, const glm::vec3& point, const glm::vec3& normal, ShadingContext& ctx);
+	bool inShadow(const LightSample& sample, OccluderCache& occluder) const;
+	int sampleLight(int l, const glm::vec3& p, const glm::vec3& norm, ShadingContext& ctx);
+	ofColor lambert(const glm::vec3& p, const glm::vec3& norm, const ofColor diffuse, ShadingContext& ctx);
+	ofColor phong(const glm::vec3& p, const glm::vec3& norm,
+		const ofColor diffuse, const ofColor specular, float power, ShadingContext& ctx);
+
+	RenderScene scene;
+	SceneGeometry geometry;		// geometry ids index into scene.objects
+
+	// image is rendered in tileSize x tileSize blocks, workers steal tiles from
+	// each other so expensive regions (soft shadows) don't leave threads idle
+	ThreadPool pool;
+	int poolThreads = 0;		// pool starts with one thread per core
+	const int tileSize = 32;
+	const int packetWidth = 8;		// packets cover packetWidth x packetWidth pixels
+	const int shadowBatch = 8;		// adaptive shadows: rays traced before checking if they agree
+	const int aaBatch = 4;			// adaptive anti-aliasing: samples added before checking the error
+	const uint32_t jitterDimension = 0;	// sample pattern of pixel jitter, light l uses 1 + l
+	int tilesX = 0, tilesY = 0;
+	float pixelAngle = 0;			// angle between the primary rays of neighboring pixels
+	vector<ShadingContext> contexts;	// one per pool thread + one for the render thread
+
+	ofPixels pixels;				// image being rendered
+	ofPixels centers;				// adaptive anti-aliasing: pixel center samples, before refining
+	AuxBuffers aux;					// written by the first pass
+	ShadowBuffers shadows;			// low rate shadows, traced before the pixels of a pass
+	Denoiser denoiser;
+	ofPixels denoised;
+	double denoiseSeconds = 0;		// of the whole render
+	ofFloatPixels accumBuffer;		// progressive: sum of all passes
+	TileCosts costs;				// tiles are only written by the thread rendering them
+	std::atomic<int> passCount{ 0 };
+	std::atomic<int> tilesDone{ 0 };
+	std::atomic<int> totalTiles{ 1 };	// of a pass, see countTiles()
+
+	// background rendering
+	std::thread thread;
+	std::atomic<bool> bCancel{ false };
+	std::atomic<bool> bRunning{ false };
+	std::atomic<bool> bFinished{ false };
+
+	// last completed pass, handed to the app by getImage()
+	std::mutex imageMutex;
+	ofPixels completed;
+	bool bNewImage = false;
+	bool bFinalImage = false;
+	RenderStats stats;
+	TileCosts completedCosts;
+	std::chrono::steady_clock::time_point renderStart;
+};
@@ -0,0 +1,223 @@
+#include "Sampler.h"
+#include <mutex>
+
+
+namespace {
+
+uint32_t reverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+// random permutation of the bits of x (as a fraction) in which every bit only
+// depends on the ones above it, i.e. an Owen scramble (Burley, "Practical
+// Hash-based Owen Scrambling", 2020)
+uint32_t owenScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+// i mirrored around the decimal point in base 3, in [0, 1)
+float radicalInverse3(uint32_t i) {
+	double value = 0, digit = 1.0 / 3;
+	for (; i; i /= 3, digit /= 3) value += (i % 3) * digit;
+	return std::min((float)value, 0.99999994f);
+}
+
+// ---- blue noise mask ----
+//
+// maskSize x maskSize ranks, tiled over the image, made once with the void and
+// cluster method (Ulichney 1993): points are added where they are furthest from
+// all others (or removed where closest), and the order they go in is the rank
+
+const int maskSize = 64;
+
+class VoidAndCluster {
+public:
+	VoidAndCluster() {
+		// gaussian falloff over the wrapped distance, so the mask tiles seamlessly
+		const float sigma = 1.5;
+		for (int dy = 0; dy < maskSize; dy++) {
+			for (int dx = 0; dx < maskSize; dx++) {
+				int wx = std::min(dx, maskSize - dx), wy = std::min(dy, maskSize - dy);
+				kernel[dy * maskSize + dx] = exp(-(wx * wx + wy * wy) / (2 * sigma * sigma));
+			}
+		}
+	}
+
+	void build(float* mask) {
+		const int n = maskSize * maskSize;
+		vector<int> rank(n);
+
+		// random initial points, spread evenly by moving the point in the tightest
+		// cluster to the largest void until that's where it already is
+		uint32_t h = 12345;
+		for (int placed = 0; placed < n / 10;) {
+			h = h * 747796405u + 2891336453u;
+			int i = (h >> 8) % n;
+			if (!points[i]) {
+				set(i, true);
+				placed++;
+			}
+		}
+		for (int iteration = 0; iteration < n; iteration++) {
+			int cluster = find(true);
+			set(cluster, false);
+			int space = find(false);
+			set(space, true);
+			if (space == cluster) break;
+		}
+		vector<uint8_t> initial(points, points + n);
+		vector<float> initialEnergy(energy, energy + n);
+		int numInitial = n / 10;
+
+		// take the initial points away tightest cluster first, they rank last
+		for (int r = numInitial - 1; r >= 0; r--) {
+			int cluster = find(true);
+			set(cluster, false);
+			rank[cluster] = r;
+		}
+
+		// then fill the largest voids from the initial points on
+		std::copy(initial.begin(), initial.end(), points);
+		std::copy(initialEnergy.begin(), initialEnergy.end(), energy);
+		for (int r = numInitial; r < n; r++) {
+			int space = find(false);
+			set(space, true);
+			rank[space] = r;
+		}
+
+		for (int i = 0; i < n; i++) mask[i] = (rank[i] + 0.5f) / n;
+	}
+
+private:
+	void set(int i, bool bPoint) {
+		points[i] = bPoint;
+		int px = i % maskSize, py = i / maskSize;
+		float sign = bPoint ? 1 : -1;
+		for (int y = 0; y < maskSize; y++) {
+			const float* row = kernel + ((y - py) & (maskSize - 1)) * maskSize;
+			for (int x = 0; x < maskSize; x++) energy[y * maskSize + x] += sign * row[(x - px) & (maskSize - 1)];
+		}
+	}
+
+	// tightest cluster of points (bPoint) or largest void between them
+	int find(bool bPoint) const {
+		int best = -1;
+		for (int i = 0; i < maskSize * maskSize; i++) {
+			if (points[i] != bPoint) continue;
+			if (best < 0 || (bPoint ? energy[i] > energy[best] : energy[i] < energy[best])) best = i;
+		}
+		return best;
+	}
+
+	float kernel[maskSize * maskSize];
+	float energy[maskSize * maskSize] = {};
+	uint8_t points[maskSize * maskSize] = {};
+};
+
+const float* getBlueNoiseMask() {
+	static float mask[maskSize * maskSize];
+	static std::once_flag built;
+	std::call_once(built, []() {
+		auto builder = std::make_unique<VoidAndCluster>();
+		builder->build(mask);
+	});
+	return mask;
+}
+
+}
+
+
+void Sampler::setup(Type type, uint32_t seed) {
+	this->type = type;
+	this->seed = seed;
+	if (type == BlueNoise) getBlueNoiseMask();
+	startPixel(x, y);
+}
+
+void Sampler::startPixel(int x, int y) {
+	this->x = x;
+	this->y = y;
+	pixelSeed = hash(seed + hash((uint32_t)x + hash((uint32_t)y)));
+}
+
+glm::vec2 Sampler::get2D(uint32_t index, uint32_t dimension) const {
+	uint32_t scramble = hash(pixelSeed ^ hash(dimension));
+
+	switch (type) {
+	case Random: {
+		uint32_t h = hash(scramble + hash(index));
+		return glm::vec2(toUnit(h), toUnit(hash(h)));
+	}
+	case Halton: {
+		glm::vec2 p(toUnit(reverseBits(index)) + toUnit(scramble), radicalInverse3(index) + toUnit(hash(scramble)));
+		if (p.x >= 1) p.x -= 1;
+		if (p.y >= 1) p.y -= 1;
+		return p;
+	}
+	case BlueNoise: {
+		// the same points in every pixel, each dimension reading the mask at
+		// offsets of its own for x and y
+		uint32_t shared = hash(seed ^ hash(dimension));
+		glm::vec2 p = getSobol(index, shared);
+		const float* mask = getBlueNoiseMask();
+		int m = maskSize - 1;
+		p.x += mask[((y + (shared >> 8)) & m) * maskSize + ((x + shared) & m)];
+		p.y += mask[((y + (shared >> 24)) & m) * maskSize + ((x + (shared >> 16)) & m)];
+		if (p.x >= 1) p.x -= 1;
+		if (p.y >= 1) p.y -= 1;
+		return p;
+	}
+	default:
+		return getSobol(index, scramble);
+	}
+}
+
+// Sobol point index in a shuffled order, both coordinates Owen scrambled
+glm::vec2 Sampler::getSobol(uint32_t index, uint32_t scramble) const {
+	uint32_t i = owenScramble(index, scramble);
+
+	// dimension 0 is the van der Corput sequence, dimension 1 has direction
+	// numbers v[k] = v[k - 1] ^ (v[k - 1] >> 1)
+	uint32_t sx = reverseBits(i);
+	uint32_t sy = 0;
+	for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1) {
+		if (i & 1) sy ^= v;
+	}
+	return glm::vec2(toUnit(owenScramble(sx, hash(scramble ^ 1))), toUnit(owenScramble(sy, hash(scramble ^ 2))));
+}
+
+// integer hash with good avalanche (lowbias32, Chris Wellons)
+uint32_t Sampler::hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+const char* Sampler::getTypeName(Type type) {
+	static const char* names[NumTypes] = { "random", "halton", "sobol", "bluenoise" };
+	return names[type];
+}
+
+bool Sampler::getType(const string& name, Type& type) {
+	for (int t = 0; t < NumTypes; t++) {
+		if (name == getTypeName((Type)t)) {
+			type = (Type)t;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ofMain.h"
+#include <cstdint>
+
+
+//  Sample patterns for jittering pixels and light samples.  Every sample is a
+//  pure function of the seed, the pixel, the sample number and the dimension
+//  (which pattern it belongs to, e.g. pixel jitter or one light's samples),
+//  so a sampler holds no shared state: threads each keep their own copy and
+//  a render comes out the same however its tiles are spread over them.
+//
+//  Random      hashed white noise, the reference the others converge faster than
+//  Halton      bases 2 and 3, randomly shifted per pixel and dimension
+//  Sobol       the first two Sobol dimensions, Owen scrambled per pixel and
+//              dimension: any first 2^k samples are stratified
+//  BlueNoise   Sobol points scrambled the same in every pixel and shifted by a
+//              blue noise mask, so the error left in neighboring pixels
+//              differs as much as possible and looks like fine grain
+class Sampler {
+public:
+	enum Type { Random, Halton, Sobol, BlueNoise, NumTypes };
+
+	void setup(Type type, uint32_t seed);
+	Type getType() const { return type; }
+
+	// take the samples of pixel (x, y) from now on
+	void startPixel(int x, int y);
+
+	// sample number index of a dimension in the current pixel, in [0, 1)^2
+	glm::vec2 get2D(uint32_t index, uint32_t dimension) const;
+
+	// dimension of stratum of a pattern that is split up, e.g. the cells of an area light
+	static uint32_t getDimension(uint32_t dimension, uint32_t stratum) { return hash(dimension * 0x9e3779b9u + stratum); }
+
+	static const char* getTypeName(Type type);	// "random", "halton", "sobol", "bluenoise"
+	static bool getType(const string& name, Type& type);
+
+private:
+	static uint32_t hash(uint32_t x);
+	static float toUnit(uint32_t x) { return (x >> 8) * (1.0f / 16777216); }
+	glm::vec2 getSobol(uint32_t index, uint32_t scramble) const;
+
+	Type type = Sobol;
+	uint32_t seed = 0;
+	int x = 0, y = 0;
+	uint32_t pixelSeed = 0;		// hash of the seed and the pixel
+};
@@ -0,0 +1,589 @@
+#include "SceneFile.h"
+#include "FilePaths.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+void SceneDescription::addObject(const RenderObject& obj, const string& diffusePath, const string& specularPath) {
+	bool bTextured = !diffusePath.empty() && !specularPath.empty();
+	scene.objects.push_back(obj);
+	diffuseMaps.push_back(bTextured ? getTextureIndex(diffusePath) : -1);
+	specularMaps.push_back(bTextured ? getTextureIndex(specularPath) : -1);
+}
+
+int SceneDescription::getTextureIndex(const string& path) {
+	for (int i = 0; i < texturePaths.size(); i++) {
+		if (texturePaths[i] == path) return i;
+	}
+	texturePaths.push_back(path);
+	return (int)texturePaths.size() - 1;
+}
+
+bool SceneDescription::loadTextures() {
+	// every map is decoded once, however many objects (or scenes) use it.
+	// Ask for all of them before waiting, so they are decoded in parallel.
+	textures.resize(texturePaths.size());
+	for (int i = 0; i < texturePaths.size(); i++) {
+		textures[i] = getTextureCache().get(texturePaths[i]);
+		if (!textures[i]) return false;
+	}
+	for (auto& texture : textures) {
+		if (!texture->wait()) return false;
+	}
+	return true;
+}
+
+void SceneDescription::update() {
+	bool bLoaded = textures.size() == texturePaths.size();
+	for (int i = 0; i < scene.objects.size(); i++) {
+		RenderObject& obj = scene.objects[i];
+		bool bTextured = bLoaded && diffuseMaps[i] >= 0 && specularMaps[i] >= 0;
+		obj.diffuseMap = bTextured ? &textures[diffuseMaps[i]]->getMap(TextureMap::Color) : nullptr;
+		obj.specularMap = bTextured ? &textures[specularMaps[i]]->getMap(TextureMap::Specular) : nullptr;
+	}
+
+	const RenderSettings& settings = scene.settings;
+	scene.view = RenderView::lookAt(camera.position, camera.target, camera.up, camera.fov,
+		settings.width / (float)settings.height);
+}
+
+
+// finish a plane read from a file: same extent and orientation as a Plane object
+static bool setupPlane(RenderObject& obj) {
+	obj.upDir = Plane::getUpDir(obj.normal);
+	return Plane::getExtent(obj.position, obj.normal, obj.width, obj.height, obj.extent);
+}
+
+static string getDirectory(const string& path) {
+	return ofFilePath::getEnclosingDirectory(getNormalizedPath(path), false);
+}
+
+
+bool loadScene(const string& path, SceneDescription& desc, bool bLoadTextures) {
+	// binary files start with a magic number, anything else is read as text
+	char magic[8] = {};
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		ofLogError("SceneFile") << "can't open " << path;
+		return false;
+	}
+	file.read(magic, sizeof(magic));
+	file.close();
+
+	bool ok = (memcmp(magic, "RTSCENE", 8) == 0) ? loadSceneBinary(path, desc) : loadSceneText(path, desc);
+	if (!ok) return false;
+	if (bLoadTextures && !desc.loadTextures()) return false;
+	desc.update();
+	return true;
+}
+
+
+// ---- text form ----
+
+// read the optional "<diffuseMap> <specularMap> <tiles>" at the end of an object line
+static bool readObject(std::istringstream& in, const string& dir, RenderObject& obj, SceneDescription& desc) {
+	string diffuse, specular;
+	if (!(in >> std::quoted(diffuse))) {
+		desc.addObject(obj);
+		return true;
+	}
+	if (!(in >> std::quoted(specular) >> obj.numTiles)) return false;
+
+	desc.addObject(obj, getNormalizedPath(ofFilePath::join(dir, diffuse)), getNormalizedPath(ofFilePath::join(dir, specular)));
+	return true;
+}
+
+bool loadSceneText(const string& path, SceneDescription& desc) {
+	std::ifstream file(path);
+	if (!file) {
+		ofLogError("SceneFile") << "can't open " << path;
+		return false;
+	}
+
+	desc = SceneDescription();
+	RenderSettings& settings = desc.scene.settings;
+	string dir = getDirectory(path);
+	string line;
+	int lineNumber = 0;
+
+	while (std::getline(file, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream in(line);
+		string key;
+		if (!(in >> key)) continue;	// blank line
+
+		bool ok = true;
+		if (key == "camera") {
+			SceneCamera& c = desc.camera;
+			ok = bool(in >> c.position.x >> c.position.y >> c.position.z >> c.target.x >> c.target.y >> c.target.z >> c.fov);
+		}
+		else if (key == "up") {
+			glm::vec3& up = desc.camera.up;
+			ok = bool(in >> up.x >> up.y >> up.z) && glm::length(up) > 0;
+		}
+		else if (key == "image") {
+			ok = bool(in >> settings.width >> settings.height) && settings.width > 0 && settings.height > 0;
+		}
+		else if (key == "threads") {
+			ok = bool(in >> settings.threads);
+		}
+		else if (key == "shading") {
+			string mode;
+			ok = bool(in >> mode >> settings.phongPower);
+			settings.lambert = (mode == "lambert");
+			settings.phong = (mode == "phong");
+			ok = ok && (settings.lambert || settings.phong || mode == "none");
+		}
+		else if (key == "ambient") {
+			ok = bool(in >> settings.ambientIntensity);
+		}
+		else if (key == "background") {
+			int r = 0, g = 0, b = 0;
+			ok = bool(in >> r >> g >> b);
+			settings.background = ofColor(r, g, b);
+		}
+		else if (key == "passes") {
+			ok = bool(in >> settings.passes) && settings.passes > 0;
+			settings.progressive = settings.passes > 1;
+		}
+		else if (key == "packets") {
+			string mode;
+			ok = bool(in >> mode) && (mode == "on" || mode == "off");
+			settings.packetTracing = (mode == "on");
+		}
+		else if (key == "shadows") {
+			string mode;
+			ok = bool(in >> mode) && (mode == "adaptive" || mode == "full");
+			settings.adaptiveShadows = (mode == "adaptive");
+			if (ok && settings.adaptiveShadows) ok = bool(in >> settings.shadowTolerance) && settings.shadowTolerance > 0;
+		}
+		else if (key == "shadowrate") {
+			ok = bool(in >> settings.shadowRate) && settings.shadowRate > 0;
+		}
+		else if (key == "sampler") {
+			string type;
+			ok = bool(in >> type >> settings.seed) && Sampler::getType(type, settings.sampler);
+		}
+		else if (key == "antialias") {
+			string mode;
+			ok = bool(in >> mode) && (mode == "adaptive" || mode == "off");
+			settings.adaptiveAA = (mode == "adaptive");
+			if (ok && settings.adaptiveAA) {
+				ok = bool(in >> settings.aaThreshold >> settings.aaMaxSamples) &&
+					settings.aaThreshold > 0 && settings.aaMaxSamples > 0;
+			}
+		}
+		else if (key == "denoise") {
+			string mode;
+			ok = bool(in >> mode) && (mode == "on" || mode == "off");
+			settings.denoise = (mode == "on");
+			if (ok && settings.denoise) ok = bool(in >> settings.denoiseIterations) && settings.denoiseIterations > 0;
+		}
+		else if (key == "sphere" || key == "plane") {
+			RenderObject obj;
+			int r = 0, g = 0, b = 0;
+			if (key == "sphere") {
+				obj.type = RenderObject::Sphere;
+				ok = bool(in >> obj.position.x >> obj.position.y >> obj.position.z >> obj.radius >> r >> g >> b);
+			}
+			else {
+				obj.type = RenderObject::Plane;
+				ok = bool(in >> obj.position.x >> obj.position.y >> obj.position.z >>
+					obj.normal.x >> obj.normal.y >> obj.normal.z >> obj.width >> obj.height >> r >> g >> b);
+				ok = ok && setupPlane(obj);	// other normals are never hit
+			}
+			obj.diffuseColor = ofColor(r, g, b);
+			ok = ok && readObject(in, dir, obj, desc);
+		}
+		else if (key == "pointlight") {
+			RenderLight light;
+			light.type = RenderLight::Point;
+			ok = bool(in >> light.position.x >> light.position.y >> light.position.z >> light.intensity);
+			desc.scene.lights.push_back(light);
+		}
+		else if (key == "arealight") {
+			RenderLight light;
+			light.type = RenderLight::Area;
+			ok = bool(in >> light.position.x >> light.position.y >> light.position.z >> light.intensity >>
+				light.width >> light.height >> light.nDivsWidth >> light.nDivsHeight >> light.nSamples);
+			ok = ok && light.nDivsWidth > 0 && light.nDivsHeight > 0 && light.nSamples > 0;
+			desc.scene.lights.push_back(light);
+		}
+		else ok = false;
+
+		if (!ok) {
+			ofLogError("SceneFile") << path << ":" << lineNumber << ": bad line \"" << line << "\"";
+			return false;
+		}
+	}
+	return true;
+}
+
+// write the "<diffuseMap> <specularMap> <tiles>" of a textured object
+static void writeTexture(std::ofstream& out, const string& dir, const SceneDescription& desc, int i) {
+	if (desc.diffuseMaps[i] < 0 || desc.specularMaps[i] < 0) return;
+	out << "  " << std::quoted(ofFilePath::makeRelative(dir, desc.texturePaths[desc.diffuseMaps[i]]))
+		<< " " << std::quoted(ofFilePath::makeRelative(dir, desc.texturePaths[desc.specularMaps[i]]))
+		<< " " << desc.scene.objects[i].numTiles;
+}
+
+bool saveSceneText(const string& path, const SceneDescription& desc) {
+	std::ofstream out(path);
+	if (!out) {
+		ofLogError("SceneFile") << "can't write " << path;
+		return false;
+	}
+
+	const RenderSettings& settings = desc.scene.settings;
+	const SceneCamera& c = desc.camera;
+	string dir = getDirectory(path);
+
+	out << "camera " << c.position.x << " " << c.position.y << " " << c.position.z << "  "
+		<< c.target.x << " " << c.target.y << " " << c.target.z << "  " << c.fov << "\n";
+	out << "up " << c.up.x << " " << c.up.y << " " << c.up.z << "\n";
+	out << "image " << settings.width << " " << settings.height << "\n";
+	out << "threads " << settings.threads << "\n";
+	out << "shading " << (settings.phong ? "phong" : settings.lambert ? "lambert" : "none") << " " << settings.phongPower << "\n";
+	out << "ambient " << settings.ambientIntensity << "\n";
+	out << "background " << (int)settings.background.r << " " << (int)settings.background.g << " " << (int)settings.background.b << "\n";
+	out << "passes " << (settings.progressive ? settings.passes : 1) << "\n";
+	out << "packets " << (settings.packetTracing ? "on" : "off") << "\n";
+	if (settings.adaptiveShadows) out << "shadows adaptive " << settings.shadowTolerance << "\n";
+	else out << "shadows full\n";
+	out << "shadowrate " << settings.shadowRate << "\n";
+	out << "sampler " << Sampler::getTypeName(settings.sampler) << " " << settings.seed << "\n";
+	if (settings.adaptiveAA) out << "antialias adaptive " << settings.aaThreshold << " " << settings.aaMaxSamples << "\n";
+	else out << "antialias off\n";
+	if (settings.denoise) out << "denoise on " << settings.denoiseIterations << "\n\n";
+	else out << "denoise off\n\n";
+
+	for (int i = 0; i < desc.scene.objects.size(); i++) {
+		const RenderObject& obj = desc.scene.objects[i];
+		const glm::vec3& p = obj.position;
+		if (obj.type == RenderObject::Sphere) {
+			out << "sphere " << p.x << " " << p.y << " " << p.z << "  " << obj.radius;
+		}
+		else {
+			out << "plane " << p.x << " " << p.y << " " << p.z << "  "
+				<< obj.normal.x << " " << obj.normal.y << " " << obj.normal.z << "  " << obj.width << " " << obj.height;
+		}
+		out << "  " << (int)obj.diffuseColor.r << " " << (int)obj.diffuseColor.g << " " << (int)obj.diffuseColor.b;
+		writeTexture(out, dir, desc, i);
+		out << "\n";
+	}
+	out << "\n";
+
+	for (auto& light : desc.scene.lights) {
+		const glm::vec3& p = light.position;
+		if (light.type == RenderLight::Point) {
+			out << "pointlight " << p.x << " " << p.y << " " << p.z << "  " << light.intensity << "\n";
+		}
+		else {
+			out << "arealight " << p.x << " " << p.y << " " << p.z << "  " << light.intensity << "  "
+				<< light.width << " " << light.height << "  " << light.nDivsWidth << " " << light.nDivsHeight << "  "
+				<< light.nSamples << "\n";
+		}
+	}
+	return bool(out);
+}
+
+
+// ---- binary form ----
+//
+// header, sphere records, plane records, light records, then the texture paths
+// (relative to the file, each NUL terminated).  Everything is 4 byte aligned and
+// in the byte order of the machine that wrote it (little endian on every target).
+
+namespace {
+
+const uint32_t binaryVersion = 6;
+
+struct BinaryHeader {
+	char magic[8];					// "RTSCENE\0"
+	uint32_t version;
+	uint32_t numSpheres, numPlanes, numLights, numTextures;
+	float camera[10];				// position, target, up, fov
+	int32_t width, height, threads, passes;
+	float phongPower, ambientIntensity;
+	uint8_t background[4];
+	uint8_t lambert, phong, packetTracing, progressive;
+	uint8_t adaptiveShadows, padding[3];
+	float shadowTolerance;
+	int32_t sampler, seed;
+	uint8_t adaptiveAA, padding2[3];
+	float aaThreshold;
+	int32_t aaMaxSamples;
+	uint8_t denoise, padding3[3];
+	int32_t denoiseIterations;
+	int32_t shadowRate;
+};
+
+struct BinarySphere {
+	float position[3];
+	float radius;
+	uint8_t color[4];
+	int32_t diffuseMap, specularMap;	// texture index, -1 = none
+	int32_t numTiles;
+};
+
+struct BinaryPlane {
+	float position[3];
+	float normal[3];
+	float width, height;
+	uint8_t color[4];
+	int32_t diffuseMap, specularMap;
+	int32_t numTiles;
+};
+
+struct BinaryLight {
+	uint32_t type;
+	float position[3];
+	float intensity;
+	float width, height;
+	int32_t nDivsWidth, nDivsHeight, nSamples;
+};
+
+static_assert(sizeof(BinaryHeader) % 4 == 0 && sizeof(BinarySphere) == 32 &&
+	sizeof(BinaryPlane) == 48 && sizeof(BinaryLight) == 40, "scene file records must not be padded");
+
+void toFloats(const glm::vec3& v, float* f) { f[0] = v.x; f[1] = v.y; f[2] = v.z; }
+glm::vec3 toVec3(const float* f) { return glm::vec3(f[0], f[1], f[2]); }
+
+}
+
+bool loadSceneBinary(const string& path, SceneDescription& desc) {
+	MappedFile file;
+	if (!file.open(path)) {
+		ofLogError("SceneFile") << "can't open " << path;
+		return false;
+	}
+
+	const BinaryHeader* header = (const BinaryHeader*)file.data();
+	if (file.size() < sizeof(BinaryHeader) || memcmp(header->magic, "RTSCENE", 8) != 0 ||
+		header->version != binaryVersion) {
+		ofLogError("SceneFile") << path << " is not a scene file (or from another version)";
+		return false;
+	}
+
+	size_t recordsSize = (size_t)header->numSpheres * sizeof(BinarySphere) +
+		(size_t)header->numPlanes * sizeof(BinaryPlane) + (size_t)header->numLights * sizeof(BinaryLight);
+	if (file.size() < sizeof(BinaryHeader) + recordsSize) {
+		ofLogError("SceneFile") << path << " is truncated";
+		return false;
+	}
+	const BinarySphere* spheres = (const BinarySphere*)(header + 1);
+	const BinaryPlane* planes = (const BinaryPlane*)(spheres + header->numSpheres);
+	const BinaryLight* lights = (const BinaryLight*)(planes + header->numPlanes);
+
+	desc = SceneDescription();
+	desc.camera.position = toVec3(header->camera);
+	desc.camera.target = toVec3(header->camera + 3);
+	desc.camera.up = toVec3(header->camera + 6);
+	desc.camera.fov = header->camera[9];
+
+	RenderSettings& settings = desc.scene.settings;
+	settings.width = header->width;
+	settings.height = header->height;
+	settings.threads = header->threads;
+	settings.passes = header->passes;
+	settings.phongPower = header->phongPower;
+	settings.ambientIntensity = header->ambientIntensity;
+	settings.background = ofColor(header->background[0], header->background[1], header->background[2]);
+	settings.lambert = header->lambert != 0;
+	settings.phong = header->phong != 0;
+	settings.packetTracing = header->packetTracing != 0;
+	settings.progressive = header->progressive != 0;
+	settings.adaptiveShadows = header->adaptiveShadows != 0;
+	settings.shadowTolerance = header->shadowTolerance;
+	settings.sampler = (header->sampler >= 0 && header->sampler < Sampler::NumTypes) ? (Sampler::Type)header->sampler : Sampler::Sobol;
+	settings.seed = header->seed;
+	settings.adaptiveAA = header->adaptiveAA != 0;
+	settings.aaThreshold = header->aaThreshold;
+	settings.aaMaxSamples = std::max(header->aaMaxSamples, 1);
+	settings.denoise = header->denoise != 0;
+	settings.denoiseIterations = std::max(header->denoiseIterations, 1);
+	settings.shadowRate = std::max(header->shadowRate, 1);
+	if (settings.width <= 0 || settings.height <= 0 || settings.passes <= 0) {
+		ofLogError("SceneFile") << path << ": bad image size or passes";
+		return false;
+	}
+
+	// texture path table
+	string dir = getDirectory(path);
+	const char* p = (const char*)(lights + header->numLights);
+	const char* end = file.data() + file.size();
+	for (uint32_t i = 0; i < header->numTextures; i++) {
+		const char* nul = (const char*)memchr(p, 0, end - p);
+		if (!nul) {
+			ofLogError("SceneFile") << path << " is truncated";
+			return false;
+		}
+		desc.texturePaths.push_back(getNormalizedPath(ofFilePath::join(dir, string(p, nul))));
+		p = nul + 1;
+	}
+
+	// objects, read straight out of the mapped records
+	int numObjects = header->numSpheres + header->numPlanes;
+	int numTextures = header->numTextures;
+	desc.scene.objects.resize(numObjects);
+	desc.diffuseMaps.resize(numObjects);
+	desc.specularMaps.resize(numObjects);
+	auto setMaps = [&](int i, int32_t diffuse, int32_t specular) {
+		bool bTextured = diffuse >= 0 && diffuse < numTextures && specular >= 0 && specular < numTextures;
+		desc.diffuseMaps[i] = bTextured ? diffuse : -1;
+		desc.specularMaps[i] = bTextured ? specular : -1;
+	};
+
+	for (uint32_t i = 0; i < header->numSpheres; i++) {
+		const BinarySphere& s = spheres[i];
+		RenderObject& obj = desc.scene.objects[i];
+		obj.type = RenderObject::Sphere;
+		obj.position = toVec3(s.position);
+		obj.radius = s.radius;
+		obj.diffuseColor = ofColor(s.color[0], s.color[1], s.color[2]);
+		obj.numTiles = s.numTiles;
+		setMaps(i, s.diffuseMap, s.specularMap);
+	}
+	for (uint32_t i = 0; i < header->numPlanes; i++) {
+		const BinaryPlane& pl = planes[i];
+		int k = header->numSpheres + i;
+		RenderObject& obj = desc.scene.objects[k];
+		obj.type = RenderObject::Plane;
+		obj.position = toVec3(pl.position);
+		obj.normal = toVec3(pl.normal);
+		obj.width = pl.width;
+		obj.height = pl.height;
+		obj.diffuseColor = ofColor(pl.color[0], pl.color[1], pl.color[2]);
+		obj.numTiles = pl.numTiles;
+		if (!setupPlane(obj)) {
+			ofLogError("SceneFile") << path << ": plane " << i << " isn't axis aligned";	// other normals are never hit
+			return false;
+		}
+		setMaps(k, pl.diffuseMap, pl.specularMap);
+	}
+
+	desc.scene.lights.resize(header->numLights);
+	for (uint32_t i = 0; i < header->numLights; i++) {
+		const BinaryLight& l = lights[i];
+		RenderLight& light = desc.scene.lights[i];
+		light.type = (l.type == RenderLight::Area) ? RenderLight::Area : RenderLight::Point;
+		light.position = toVec3(l.position);
+		light.intensity = l.intensity;
+		light.width = l.width;
+		light.height = l.height;
+		light.nDivsWidth = std::max(l.nDivsWidth, 1);
+		light.nDivsHeight = std::max(l.nDivsHeight, 1);
+		light.nSamples = std::max(l.nSamples, 1);
+	}
+	return true;
+}
+
+bool saveSceneBinary(const string& path, const SceneDescription& desc) {
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		ofLogError("SceneFile") << "can't write " << path;
+		return false;
+	}
+
+	const RenderSettings& settings = desc.scene.settings;
+	const vector<RenderObject>& objects = desc.scene.objects;
+	BinaryHeader header = {};
+	memcpy(header.magic, "RTSCENE", 8);
+	header.version = binaryVersion;
+	for (auto& obj : objects) {
+		if (obj.type == RenderObject::Sphere) header.numSpheres++;
+		else header.numPlanes++;
+	}
+	header.numLights = (uint32_t)desc.scene.lights.size();
+	header.numTextures = (uint32_t)desc.texturePaths.size();
+	toFloats(desc.camera.position, header.camera);
+	toFloats(desc.camera.target, header.camera + 3);
+	toFloats(desc.camera.up, header.camera + 6);
+	header.camera[9] = desc.camera.fov;
+	header.width = settings.width;
+	header.height = settings.height;
+	header.threads = settings.threads;
+	header.passes = settings.passes;
+	header.phongPower = settings.phongPower;
+	header.ambientIntensity = settings.ambientIntensity;
+	header.background[0] = settings.background.r;
+	header.background[1] = settings.background.g;
+	header.background[2] = settings.background.b;
+	header.background[3] = 255;
+	header.lambert = settings.lambert;
+	header.phong = settings.phong;
+	header.packetTracing = settings.packetTracing;
+	header.progressive = settings.progressive;
+	header.adaptiveShadows = settings.adaptiveShadows;
+	header.shadowTolerance = settings.shadowTolerance;
+	header.sampler = settings.sampler;
+	header.seed = settings.seed;
+	header.adaptiveAA = settings.adaptiveAA;
+	header.aaThreshold = settings.aaThreshold;
+	header.aaMaxSamples = settings.aaMaxSamples;
+	header.denoise = settings.denoise;
+	header.denoiseIterations = settings.denoiseIterations;
+	header.shadowRate = settings.shadowRate;
+	out.write((const char*)&header, sizeof(header));
+
+	// records of each type are gathered into one buffer and written at once
+	vector<BinarySphere> spheres;
+	vector<BinaryPlane> planes;
+	spheres.reserve(header.numSpheres);
+	planes.reserve(header.numPlanes);
+	for (int i = 0; i < objects.size(); i++) {
+		const RenderObject& obj = objects[i];
+		if (obj.type == RenderObject::Sphere) {
+			BinarySphere s = {};
+			toFloats(obj.position, s.position);
+			s.radius = obj.radius;
+			s.color[0] = obj.diffuseColor.r;
+			s.color[1] = obj.diffuseColor.g;
+			s.color[2] = obj.diffuseColor.b;
+			s.diffuseMap = desc.diffuseMaps[i];
+			s.specularMap = desc.specularMaps[i];
+			s.numTiles = obj.numTiles;
+			spheres.push_back(s);
+		}
+		else {
+			BinaryPlane pl = {};
+			toFloats(obj.position, pl.position);
+			toFloats(obj.normal, pl.normal);
+			pl.width = obj.width;
+			pl.height = obj.height;
+			pl.color[0] = obj.diffuseColor.r;
+			pl.color[1] = obj.diffuseColor.g;
+			pl.color[2] = obj.diffuseColor.b;
+			pl.diffuseMap = desc.diffuseMaps[i];
+			pl.specularMap = desc.specularMaps[i];
+			pl.numTiles = obj.numTiles;
+			planes.push_back(pl);
+		}
+	}
+	out.write((const char*)spheres.data(), spheres.size() * sizeof(BinarySphere));
+	out.write((const char*)planes.data(), planes.size() * sizeof(BinaryPlane));
+
+	for (auto& light : desc.scene.lights) {
+		BinaryLight l = {};
+		l.type = light.type;
+		toFloats(light.position, l.position);
+		l.intensity = light.intensity;
+		l.width = light.width;
+		l.height = light.height;
+		l.nDivsWidth = light.nDivsWidth;
+		l.nDivsHeight = light.nDivsHeight;
+		l.nSamples = light.nSamples;
+		out.write((const char*)&l, sizeof(l));
+	}
+
+	string dir = getDirectory(path);
+	for (auto& texturePath : desc.texturePaths) {
+		string relative = ofFilePath::makeRelative(dir, texturePath);
+		out.write(relative.c_str(), relative.size() + 1);
+	}
+	return bool(out);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Renderer.h"
+#include "TextureCache.h"
+
+
+//  Scene files: objects, lights, materials, texture maps, camera and render settings.
+//
+//  The text form has one entry per line, '#' starts a comment:
+//
+//    camera <x> <y> <z>  <targetX> <targetY> <targetZ>  <fov>
+//    up <x> <y> <z>                   up direction of the camera, optional (default 0 1 0)
+//    image <width> <height>
+//    threads <n>                      0 = all cores
+//    shading none|lambert|phong <phongPower>
+//    ambient <intensity>
+//    background <r> <g> <b>
+//    passes <n>                       > 1 renders n progressive passes (anti-aliasing, light samples)
+//    packets on|off
+//    shadows adaptive <tolerance>|full  area light shadow rays: stop early where the samples agree,
+//                                       or trace every one
+//    shadowrate <n>                   trace area light shadows once per n x n pixels and upsample them
+//    sampler random|halton|sobol|bluenoise <seed>  pattern of pixel jitter and light samples
+//    antialias adaptive <threshold> <maxSamples>|off  supersample pixels that differ from their neighbors
+//    denoise on <iterations>|off      edge-aware filter over the noise of area light samples
+//    sphere <x> <y> <z> <radius> <r> <g> <b> [<diffuseMap> <specularMap> <tiles>]
+//    plane <x> <y> <z> <nx> <ny> <nz> <width> <height> <r> <g> <b> [<diffuseMap> <specularMap> <tiles>]
+//    pointlight <x> <y> <z> <intensity>
+//    arealight <x> <y> <z> <intensity> <width> <height> <divsWidth> <divsHeight> <samplesPerCell>
+//
+//  Texture maps are paths relative to the scene file, in quotes if they contain spaces.
+//
+//  The binary form holds the same data as fixed size records behind a small
+//  header.  It is memory mapped and read in place, so even scenes with millions
+//  of spheres load in a fraction of a second.  Spheres come before planes when
+//  loaded from it.
+
+
+// the render cam of a scene: looks from position at target, fov is vertical in degrees
+struct SceneCamera {
+	glm::vec3 position = glm::vec3(0, 0, 10);
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	glm::vec3 up = glm::vec3(0, 1, 0);
+	float fov = 60;
+};
+
+
+struct SceneDescription {
+	RenderScene scene;			// view is set from camera by update()
+	SceneCamera camera;
+
+	// scene.objects[i] uses texturePaths[diffuseMaps[i]] and texturePaths[specularMaps[i]]
+	// (-1 if untextured).  textures holds the decoded maps the objects point to,
+	// it stays empty if the scene was loaded without textures.
+	vector<string> texturePaths;	// absolute
+	vector<TextureHandle> textures;
+	vector<int> diffuseMaps, specularMaps;
+
+	// add an object with optional texture maps (absolute paths, both or neither)
+	void addObject(const RenderObject& obj, const string& diffusePath = "", const string& specularPath = "");
+	int getTextureIndex(const string& path);	// index in texturePaths, added if new
+
+	// get every texture map from the texture cache and wait until they are decoded,
+	// false if one can't be loaded
+	bool loadTextures();
+
+	// point the objects at their decoded maps and the view at the camera
+	void update();
+};
+
+
+// load a text or binary scene file (told apart by its contents) and decode its
+// textures unless bLoadTextures is false.  Paths are relative to the working
+// directory (not bin/data).  On errors these log why and return false.
+bool loadScene(const string& path, SceneDescription& desc, bool bLoadTextures = true);
+bool loadSceneText(const string& path, SceneDescription& desc);
+bool loadSceneBinary(const string& path, SceneDescription& desc);
+
+bool saveSceneText(const string& path, const SceneDescription& desc);
+bool saveSceneBinary(const string& path, const SceneDescription& desc);
@@ -0,0 +1,168 @@
+#include "SceneGeometry.h"
+#include <limits>
+
+
+void SceneGeometry::clear() {
+	newSpheres.clear();
+	newPlanes.clear();
+	spheres.resize(0);
+	planes.resize(0);
+	sphereIds.clear();
+	planeIds.clear();
+	sphereBvh.clear();
+	planeBvh.clear();
+}
+
+void SceneGeometry::addSphere(const glm::vec3& center, float radius, int id) {
+	newSpheres.push_back(SphereDesc{ center, radius, id });
+}
+
+void SceneGeometry::addPlane(const glm::vec3& position, const glm::vec3& normal, const Aabb& extent, int id) {
+	newPlanes.push_back(PlaneDesc{ position, normal, extent, id });
+}
+
+void SceneGeometry::build(ThreadPool* pool) {
+	// leaves hold up to one kernel's worth of primitives
+	std::vector<Aabb> bounds(newSpheres.size());
+	for (int i = 0; i < (int)newSpheres.size(); i++) {
+		bounds[i].grow(newSpheres[i].center - glm::vec3(newSpheres[i].radius));
+		bounds[i].grow(newSpheres[i].center + glm::vec3(newSpheres[i].radius));
+	}
+	sphereBvh.build(bounds, pool, kernelWidth);
+
+	bounds.resize(newPlanes.size());
+	for (int i = 0; i < (int)newPlanes.size(); i++) bounds[i] = newPlanes[i].extent;
+	planeBvh.build(bounds, pool, kernelWidth);
+
+	// copy primitives into the arrays in leaf order
+	int n = (int)newSpheres.size();
+	spheres.resize(n);
+	sphereIds.resize(n);
+	for (int k = 0; k < n; k++) {
+		const SphereDesc& s = newSpheres[sphereBvh.primIndices[k]];
+		spheres.cx[k] = s.center.x;
+		spheres.cy[k] = s.center.y;
+		spheres.cz[k] = s.center.z;
+		spheres.radius[k] = s.radius;
+		sphereIds[k] = s.id;
+		sphereBvh.primIndices[k] = k;
+	}
+
+	n = (int)newPlanes.size();
+	planes.resize(n);
+	planeIds.resize(n);
+	for (int k = 0; k < n; k++) {
+		const PlaneDesc& p = newPlanes[planeBvh.primIndices[k]];
+		planes.px[k] = p.position.x;
+		planes.py[k] = p.position.y;
+		planes.pz[k] = p.position.z;
+		planes.nx[k] = p.normal.x;
+		planes.ny[k] = p.normal.y;
+		planes.nz[k] = p.normal.z;
+		planes.minX[k] = p.extent.min.x;
+		planes.minY[k] = p.extent.min.y;
+		planes.minZ[k] = p.extent.min.z;
+		planes.maxX[k] = p.extent.max.x;
+		planes.maxY[k] = p.extent.max.y;
+		planes.maxZ[k] = p.extent.max.z;
+		planeIds[k] = p.id;
+		planeBvh.primIndices[k] = k;
+	}
+
+	newSpheres.clear();
+	newPlanes.clear();
+}
+
+bool SceneGeometry::intersect(const glm::vec3& o, const glm::vec3& d, GeometryHit& hit) const {
+	float tMax = std::numeric_limits<float>::infinity();
+	int sphereHit = -1, planeHit = -1;
+
+	// both hierarchies share tMax, so whichever is traversed second is culled by the first
+	planeBvh.closestHit(o, d, tMax, [&](int first, int count, float& t) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return intersectPlanes(planes, first, count, o, d, t, planeHit);
+	});
+	bool hitSphere = sphereBvh.closestHit(o, d, tMax, [&](int first, int count, float& t) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return intersectSpheres(spheres, first, count, o, d, t, sphereHit);
+	});
+	if (sphereHit < 0 && planeHit < 0) return false;
+
+	fillHit(o, d, tMax, hitSphere ? sphereHit : -1, planeHit, hit);
+	return true;
+}
+
+void SceneGeometry::intersectPacket(const RayPacket& packet, GeometryHit* hits, bool* bHit) const {
+	float tMax[RayPacket::maxRays];
+	float tPlane[RayPacket::maxRays];
+	int sphereHit[RayPacket::maxRays];
+	int planeHit[RayPacket::maxRays];
+	for (int i = 0; i < packet.count; i++) {
+		tMax[i] = std::numeric_limits<float>::infinity();
+		sphereHit[i] = -1;
+		planeHit[i] = -1;
+	}
+
+	planeBvh.closestHitPacket(packet, tMax, [&](int ray, int first, int count, float& t) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return intersectPlanes(planes, first, count, packet.origin(ray), packet.dir(ray), t, planeHit[ray]);
+	});
+	for (int i = 0; i < packet.count; i++) tPlane[i] = tMax[i];
+	sphereBvh.closestHitPacket(packet, tMax, [&](int ray, int first, int count, float& t) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return intersectSpheres(spheres, first, count, packet.origin(ray), packet.dir(ray), t, sphereHit[ray]);
+	});
+
+	for (int i = 0; i < packet.count; i++) {
+		// a sphere only counts if it is closer than the plane hit
+		bool hitSphere = sphereHit[i] >= 0 && tMax[i] < tPlane[i];
+		bHit[i] = hitSphere || planeHit[i] >= 0;
+		if (bHit[i]) fillHit(packet.origin(i), packet.dir(i), tMax[i], hitSphere ? sphereHit[i] : -1, planeHit[i], hits[i]);
+	}
+}
+
+// hit point and normal of the closest hit (sphere if sphereHit >= 0, else plane)
+void SceneGeometry::fillHit(const glm::vec3& o, const glm::vec3& d, float t, int sphereHit, int planeHit, GeometryHit& hit) const {
+	hit.t = t;
+	hit.point = o + t * d;
+	if (sphereHit >= 0) {
+		glm::vec3 center(spheres.cx[sphereHit], spheres.cy[sphereHit], spheres.cz[sphereHit]);
+		hit.normal = (hit.point - center) / spheres.radius[sphereHit];
+		hit.id = sphereIds[sphereHit];
+	}
+	else {
+		hit.normal = glm::vec3(planes.nx[planeHit], planes.ny[planeHit], planes.nz[planeHit]);
+		hit.id = planeIds[planeHit];
+	}
+}
+
+bool SceneGeometry::occluded(const glm::vec3& o, const glm::vec3& d, float tMin, float tMax,
+	OccluderCache* cache) const {
+	int hitIndex;
+
+	// try the last occluder before anything else
+	if (cache && cache->type != OccluderCache::None) RT_STAT_COUNT(RenderStats::IntersectionTests, 1);
+	if (cache && cache->type == OccluderCache::Sphere && cache->index < spheres.count &&
+		occludedSpheresScalar(spheres, cache->index, 1, o, d, tMin, tMax, hitIndex)) return true;
+	if (cache && cache->type == OccluderCache::Plane && cache->index < planes.count &&
+		occludedPlanesScalar(planes, cache->index, 1, o, d, tMin, tMax, hitIndex)) return true;
+
+	bool hitPlane = planeBvh.anyHit(o, d, tMin, tMax, [&](int first, int count) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return occludedPlanes(planes, first, count, o, d, tMin, tMax, hitIndex);
+	});
+	if (hitPlane) {
+		if (cache) *cache = OccluderCache{ OccluderCache::Plane, hitIndex };
+		return true;
+	}
+
+	bool hitSphere = sphereBvh.anyHit(o, d, tMin, tMax, [&](int first, int count) {
+		RT_STAT_COUNT(RenderStats::IntersectionTests, count);
+		return occludedSpheres(spheres, first, count, o, d, tMin, tMax, hitIndex);
+	});
+	if (hitSphere) {
+		if (cache) *cache = OccluderCache{ OccluderCache::Sphere, hitIndex };
+		return true;
+	}
+	return false;
+}
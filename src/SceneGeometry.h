@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Bvh.h"
+#include "IntersectKernels.h"
+#include "RenderStats.h"
+
+
+// the primitive that blocked the previous shadow ray of a light, tested first
+// on the next query since neighboring shadow rays tend to hit the same object
+struct OccluderCache {
+	enum Type { None, Sphere, Plane };
+	Type type = None;
+	int index = 0;
+};
+
+
+// closest hit found by SceneGeometry::intersect()
+struct GeometryHit {
+	float t;
+	int id;				// id given to addSphere()/addPlane()
+	glm::vec3 point;
+	glm::vec3 normal;
+};
+
+
+//  Render-side copy of the scene geometry: spheres and planes in
+//  structure-of-arrays form, each with its own bvh.  After build() the arrays
+//  are stored in bvh leaf order, so every leaf is a contiguous range that the
+//  8-wide kernels test in one go.
+class SceneGeometry {
+public:
+	void clear();
+	void addSphere(const glm::vec3& center, float radius, int id);
+	void addPlane(const glm::vec3& position, const glm::vec3& normal, const Aabb& extent, int id);
+
+	// build the bvhs (in parallel on the pool, if given) and reorder the arrays
+	void build(ThreadPool* pool = nullptr);
+
+	bool intersect(const glm::vec3& o, const glm::vec3& d, GeometryHit& hit) const;
+	// closest hits for every ray of a packet, bHit[i] tells whether ray i hit anything
+	void intersectPacket(const RayPacket& packet, GeometryHit* hits, bool* bHit) const;
+	// shadow query: true as soon as anything is hit between tMin and tMax.
+	// cache (optional) is checked first and updated with the occluder found.
+	bool occluded(const glm::vec3& o, const glm::vec3& d, float tMin, float tMax,
+		OccluderCache* cache = nullptr) const;
+
+	int numSpheres() const { return spheres.count; }
+	int numPlanes() const { return planes.count; }
+
+	SphereArrays spheres;
+	PlaneArrays planes;
+	std::vector<int> sphereIds, planeIds;
+	Bvh sphereBvh, planeBvh;
+
+private:
+	void fillHit(const glm::vec3& o, const glm::vec3& d, float t, int sphereHit, int planeHit, GeometryHit& hit) const;
+
+	// primitives added since the last build, in insertion order
+	struct SphereDesc { glm::vec3 center; float radius; int id; };
+	struct PlaneDesc { glm::vec3 position, normal; Aabb extent; int id; };
+	std::vector<SphereDesc> newSpheres;
+	std::vector<PlaneDesc> newPlanes;
+};
@@ -0,0 +1,200 @@
+#include "TextureCache.h"
+#include "FilePaths.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+
+bool Texture::wait() const {
+	done.wait();
+	return isReady();
+}
+
+// gray checkerboard in place of maps that are still loading (or failed to)
+static const TextureMap& getPlaceholder(TextureMap::Format format) {
+	static TextureMap maps[2];
+	static std::once_flag built;
+	std::call_once(built, []() {
+		ofPixels pixels;
+		pixels.allocate(64, 64, OF_PIXELS_RGB);
+		for (int y = 0; y < 64; y++) {
+			for (int x = 0; x < 64; x++) pixels.setColor(x, y, ((x / 8 + y / 8) % 2) ? ofColor(160) : ofColor(96));
+		}
+		maps[TextureMap::Color].setup(pixels, TextureMap::Color);
+		maps[TextureMap::Specular].setup(pixels, TextureMap::Specular);
+	});
+	return maps[format];
+}
+
+const TextureMap& Texture::getMap(TextureMap::Format format) const {
+	return isReady() ? maps[format] : getPlaceholder(format);
+}
+
+
+// ---- cache files ----
+//
+// header, then the color and specular maps as TextureMap records.  Byte order
+// is the machine's, like binary scene files.
+
+namespace {
+
+const uint32_t cacheVersion = 2;
+
+struct CacheHeader {
+	char magic[8];			// "RTTEX\0\0\0"
+	uint32_t version;
+	uint32_t numMaps;
+	uint64_t sourceSize;	// of the image the maps were made from
+	int64_t sourceTime;		// its modification time, in file clock ticks
+};
+
+string getCachePath(const string& imagePath) {
+	return imagePath + ".rtex";
+}
+
+// a cache file is stale once the image's size or modification time changes
+bool getSourceStamp(const string& path, uint64_t& size, int64_t& time) {
+	std::error_code error;
+	size = std::filesystem::file_size(path, error);
+	if (error) return false;
+	time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	return !error;
+}
+
+}
+
+bool TextureCache::mapCacheFile(Texture& texture, bool bCompressed) {
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (!getSourceStamp(texture.path, sourceSize, sourceTime)) return false;
+
+	auto file = std::make_shared<MappedFile>();
+	if (!file->open(getCachePath(texture.path)) || file->size() < sizeof(CacheHeader)) return false;
+	CacheHeader header;
+	memcpy(&header, file->data(), sizeof(header));
+	if (memcmp(header.magic, "RTTEX\0\0\0", 8) != 0 || header.version != cacheVersion || header.numMaps != 2 ||
+		header.sourceSize != sourceSize || header.sourceTime != sourceTime) return false;
+
+	size_t offset = sizeof(header);
+	TextureMap& color = texture.maps[TextureMap::Color];
+	TextureMap& specular = texture.maps[TextureMap::Specular];
+	return color.setup(file, offset) && specular.setup(file, offset) &&
+		color.getFormat() == TextureMap::Color && specular.getFormat() == TextureMap::Specular &&
+		color.isCompressed() == bCompressed && specular.isCompressed() == bCompressed;
+}
+
+bool TextureCache::writeCacheFile(const Texture& texture) {
+	CacheHeader header = {};
+	memcpy(header.magic, "RTTEX\0\0\0", 8);
+	header.version = cacheVersion;
+	header.numMaps = 2;
+	if (!getSourceStamp(texture.path, header.sourceSize, header.sourceTime)) return false;
+
+	// written under another name and renamed once complete, so nobody maps half a file
+	string path = getCachePath(texture.path);
+	string temp = path + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary);
+		out.write((const char*)&header, sizeof(header));
+		bool ok = texture.maps[TextureMap::Color].write(out) && texture.maps[TextureMap::Specular].write(out);
+		out.close();
+		if (!ok || !out) {
+			ofLogWarning("TextureCache") << "can't write " << path;
+			std::error_code error;
+			std::filesystem::remove(temp, error);
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temp, path, error);
+	if (error) {
+		ofLogWarning("TextureCache") << "can't write " << path << ": " << error.message();
+		std::filesystem::remove(temp, error);
+		return false;
+	}
+	return true;
+}
+
+// decode the image and build its maps, then write them to a cache file and
+// sample that instead of the copies in memory
+bool TextureCache::decode(Texture& texture, bool bCompressed) {
+	ofPixels pixels;
+	if (!ofLoadImage(pixels, texture.path)) {
+		ofLogError("TextureCache") << "can't load texture " << texture.path;
+		return false;
+	}
+	texture.maps[TextureMap::Color].setup(pixels, TextureMap::Color, bCompressed);
+	texture.maps[TextureMap::Specular].setup(pixels, TextureMap::Specular, bCompressed);
+
+	if (writeCacheFile(texture) && !mapCacheFile(texture, bCompressed)) {
+		// mapping clears the maps if it fails part way
+		texture.maps[TextureMap::Color].setup(pixels, TextureMap::Color, bCompressed);
+		texture.maps[TextureMap::Specular].setup(pixels, TextureMap::Specular, bCompressed);
+	}
+	return true;
+}
+
+bool TextureCache::convert(const string& path, bool bCompressed) {
+	Texture texture;
+	texture.path = getKey(path);
+	if (mapCacheFile(texture, bCompressed)) return true;
+	return decode(texture, bCompressed) && texture.maps[TextureMap::Color].isMapped();
+}
+
+
+string TextureCache::getKey(const string& path) {
+	return getNormalizedPath(ofToDataPath(path, true));
+}
+
+TextureHandle TextureCache::get(const string& path) {
+	string key = getKey(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	TextureHandle texture = textures[key].lock();
+	if (texture) return texture;
+
+	if (!ofFile::doesFileExist(key, false)) {
+		ofLogError("TextureCache") << "can't load texture " << key;
+		textures.erase(key);
+		return nullptr;
+	}
+
+	// an up to date cache file is ready at once, mapping it costs next to nothing
+	auto loading = std::make_shared<Texture>();
+	loading->path = key;
+	textures[key] = loading;
+	bool bCompress = bCompressed;
+	if (mapCacheFile(*loading, bCompress)) {
+		loading->state = Texture::Ready;
+		loading->loaded.set_value();
+		return loading;
+	}
+
+	// the task holds on to the texture until it is decoded, even if every
+	// handle is dropped before that
+	loaders.submit([loading, bCompress]() {
+		loading->state = decode(*loading, bCompress) ? Texture::Ready : Texture::Failed;
+		loading->loaded.set_value();
+	});
+	return loading;
+}
+
+int TextureCache::size() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// forget the maps nobody holds anymore while counting
+	int count = 0;
+	for (auto it = textures.begin(); it != textures.end();) {
+		if (it->second.expired()) it = textures.erase(it);
+		else {
+			count++;
+			++it;
+		}
+	}
+	return count;
+}
+
+TextureCache& getTextureCache() {
+	static TextureCache cache;
+	return cache;
+}
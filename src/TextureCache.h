@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ofMain.h"
+#include "TextureMap.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
+
+// texture map, never changed once loaded.  Maps are loaded in the background,
+// getMap() only returns them once isReady().
+struct Texture {
+	enum State { Loading, Ready, Failed };
+
+	string path;		// of the image, absolute, the key in the cache
+
+	State getState() const { return state; }
+	bool isReady() const { return state == Ready; }
+	// block until the map is loaded (or failed to), true if it is ready
+	bool wait() const;
+
+	// the map in the layout the renderer samples, a placeholder checkerboard
+	// until the texture is ready.  Thread safe.
+	const TextureMap& getMap(TextureMap::Format format) const;
+
+private:
+	friend class TextureCache;
+	std::atomic<State> state{ Loading };
+	std::promise<void> loaded;
+	std::shared_future<void> done = loaded.get_future().share();
+	TextureMap maps[2];		// by format, written before the state turns Ready
+};
+
+// shared, read-only reference to a texture map.  Copying one is all it takes
+// to give another object the same map.
+typedef std::shared_ptr<const Texture> TextureHandle;
+
+
+//  Every texture map in use, loaded once however many objects or scenes use
+//  it.  The cache only keeps weak references: a map is freed when the last
+//  handle to it goes away, and loaded again if it is asked for after that.
+//
+//  The first time an image is loaded, it is decoded on a pool of loader
+//  threads (so asking for several at once decodes them in parallel and never
+//  blocks the caller) and its maps are written to a cache file next to it,
+//  "<image>.rtex".  Later loads memory map that file and sample it in place:
+//  nothing is decoded or copied, and only the pages the renderer touches are
+//  ever read.  A cache file is rebuilt when the image's size or modification
+//  time changes, or it isn't compressed the way the cache is set to.
+class TextureCache {
+public:
+	// the map at path (relative to bin/data, or absolute), loading starts on
+	// first use.  Null if there is no such file.  Thread safe.
+	TextureHandle get(const string& path);
+
+	// the key of path in the cache, i.e. Texture::path
+	static string getKey(const string& path);
+
+	// load maps compressed (see TextureMap) from now on, to fit many more of
+	// them in memory.  Maps already loaded stay as they are.
+	void setCompressed(bool bCompress) { bCompressed = bCompress; }
+	bool isCompressed() const { return bCompressed; }
+
+	// write the cache file of the image at path now, unless it is up to date.
+	// False if the image can't be decoded or the file can't be written.
+	static bool convert(const string& path, bool bCompressed = false);
+
+	// maps currently alive
+	int size();
+
+private:
+	static bool mapCacheFile(Texture& texture, bool bCompressed);
+	static bool decode(Texture& texture, bool bCompressed);
+	static bool writeCacheFile(const Texture& texture);
+
+	std::atomic<bool> bCompressed{ false };
+	std::mutex mutex;
+	map<string, std::weak_ptr<const Texture>> textures;
+	ThreadPool loaders;
+};
+
+// the cache shared by the whole program
+TextureCache& getTextureCache();
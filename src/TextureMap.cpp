@@ -0,0 +1,371 @@
+#include "TextureMap.h"
+#include <climits>
+#include <cstring>
+#include <ostream>
+
+
+// a map file record: header, then the texels of every level.  Levels are
+// whole tiles (or blocks), so records stay 4 byte aligned.
+struct MapRecord {
+	uint32_t format;
+	uint32_t compressed;
+	int32_t width, height;
+	uint32_t numValues;		// 16 bit values of all levels
+};
+
+size_t TextureMap::setupLevels(int width, int height, uint16_t* texels) {
+	// every level halves the one above, down to 1x1
+	levels.clear();
+	size_t offset = 0;
+	while (true) {
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.tilesX = (width + tileSize - 1) / tileSize;
+		int tilesY = (height + tileSize - 1) / tileSize;
+		level.texels = texels ? texels + offset : nullptr;
+		levels.push_back(level);
+		offset += (size_t)level.tilesX * tilesY * getTileValues();
+
+		if (width == 1 && height == 1) break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return offset;
+}
+
+void TextureMap::setup(const ofPixels& pixels, Format f, bool bCompress) {
+	format = f;
+	channels = (format == Color) ? 4 : 1;
+	bCompressed = false;
+	levels.clear();
+	storage.clear();
+	file.reset();
+	if (!pixels.isAllocated()) return;
+
+	numValues = setupLevels(pixels.getWidth(), pixels.getHeight(), nullptr);
+	storage.assign(numValues, 0);
+	setupLevels(pixels.getWidth(), pixels.getHeight(), storage.data());
+
+	// level 0, 8 bit values scaled to the full 16 bit range (255 * 257 = 65535)
+	for (int y = 0; y < levels[0].height; y++) {
+		for (int x = 0; x < levels[0].width; x++) {
+			ofColor c = pixels.getColor(x, y);
+			uint16_t* texel = getTexel(levels[0], x, y);
+			if (format == Color) {
+				texel[0] = c.r * 257;
+				texel[1] = c.g * 257;
+				texel[2] = c.b * 257;
+				texel[3] = 65535;
+			}
+			else texel[0] = c.getBrightness() * 257;
+		}
+	}
+
+	// every further level averages 2x2 texels of the one above.
+	// Odd sizes drop their last row / column.
+	for (int l = 1; l < levels.size(); l++) {
+		const Level& src = levels[l - 1];
+		Level& dst = levels[l];
+		for (int y = 0; y < dst.height; y++) {
+			int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+			for (int x = 0; x < dst.width; x++) {
+				int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+				const uint16_t* a = getTexel(src, x0, y0, nullptr);
+				const uint16_t* b = getTexel(src, x1, y0, nullptr);
+				const uint16_t* c = getTexel(src, x0, y1, nullptr);
+				const uint16_t* d = getTexel(src, x1, y1, nullptr);
+				uint16_t* texel = getTexel(dst, x, y);
+				for (int k = 0; k < channels; k++) texel[k] = (a[k] + b[k] + c[k] + d[k] + 2) / 4;
+			}
+		}
+	}
+
+	if (bCompress) compress();
+}
+
+
+// ---- block compression ----
+//
+// BC1 block: rgb565 endpoints c0 > c1, then a 2 bit index per texel into
+// c0, c1, 2/3 c0 + 1/3 c1 and 1/3 c0 + 2/3 c1.
+// BC4 block: 8 bit endpoints r0 > r1, then a 3 bit index per texel into r0,
+// r1 and the 6 values evenly between them.
+// Equal endpoints (flat blocks) use index 0 only.  Texels are numbered row by
+// row within the block, index i is at bit 2i (BC1) or 3i (BC4) of the indices.
+
+static int to8(uint16_t value) { return (value + 128) / 257; }
+
+static uint16_t packRgb565(const float* c) {
+	int r = ofClamp(c[0] * 31 / 255 + 0.5f, 0, 31);
+	int g = ofClamp(c[1] * 63 / 255 + 0.5f, 0, 63);
+	int b = ofClamp(c[2] * 31 / 255 + 0.5f, 0, 31);
+	return (r << 11) | (g << 5) | b;
+}
+
+static void unpackRgb565(uint16_t c, int* rgb) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void getBc1Palette(uint16_t c0, uint16_t c1, int palette[4][3]) {
+	unpackRgb565(c0, palette[0]);
+	unpackRgb565(c1, palette[1]);
+	for (int k = 0; k < 3; k++) {
+		palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+		palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+	}
+}
+
+static int getBc4Value(int r0, int r1, int index) {
+	if (index < 2) return index ? r1 : r0;
+	return ((8 - index) * r0 + (index - 1) * r1) / 7;
+}
+
+// tile holds 16 rgba texels, only the first validW x validH are part of the image
+static void encodeBc1(const uint16_t* tile, int validW, int validH, uint16_t* block) {
+	float colors[16][3];
+	int n = 0;
+	for (int y = 0; y < validH; y++) {
+		for (int x = 0; x < validW; x++, n++) {
+			for (int k = 0; k < 3; k++) colors[n][k] = to8(tile[(y * 4 + x) * 4 + k]);
+		}
+	}
+
+	// endpoints at the ends of the colors' principal axis (a few power iterations)
+	float mean[3] = {}, cov[3][3] = {};
+	for (int i = 0; i < n; i++) {
+		for (int k = 0; k < 3; k++) mean[k] += colors[i][k] / n;
+	}
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < 3; j++) {
+			for (int k = 0; k < 3; k++) cov[j][k] += (colors[i][j] - mean[j]) * (colors[i][k] - mean[k]);
+		}
+	}
+	float axis[3] = { 1, 1, 1 };
+	for (int i = 0; i < 8; i++) {
+		float next[3];
+		for (int j = 0; j < 3; j++) next[j] = cov[j][0] * axis[0] + cov[j][1] * axis[1] + cov[j][2] * axis[2];
+		float len = sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (len < 1e-6f) break;
+		for (int j = 0; j < 3; j++) axis[j] = next[j] / len;
+	}
+	float tMin = 0, tMax = 0;
+	for (int i = 0; i < n; i++) {
+		float t = 0;
+		for (int k = 0; k < 3; k++) t += (colors[i][k] - mean[k]) * axis[k];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+
+	float e0[3], e1[3];
+	for (int k = 0; k < 3; k++) {
+		e0[k] = mean[k] + axis[k] * tMax;
+		e1[k] = mean[k] + axis[k] * tMin;
+	}
+	uint16_t c0 = packRgb565(e0);
+	uint16_t c1 = packRgb565(e1);
+	if (c0 < c1) std::swap(c0, c1);
+	block[0] = c0;
+	block[1] = c1;
+	block[2] = block[3] = 0;
+	if (c0 == c1) return;
+
+	int palette[4][3];
+	getBc1Palette(c0, c1, palette);
+	uint32_t indices = 0;
+	for (int y = 0; y < validH; y++) {
+		for (int x = 0; x < validW; x++) {
+			const uint16_t* t = tile + (y * 4 + x) * 4;
+			int best = 0, bestError = INT_MAX;
+			for (int p = 0; p < 4; p++) {
+				int dr = to8(t[0]) - palette[p][0], dg = to8(t[1]) - palette[p][1], db = to8(t[2]) - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError) {
+					best = p;
+					bestError = error;
+				}
+			}
+			indices |= (uint32_t)best << (2 * (y * 4 + x));
+		}
+	}
+	block[2] = indices & 0xffff;
+	block[3] = indices >> 16;
+}
+
+// tile holds 16 single channel texels
+static void encodeBc4(const uint16_t* tile, int validW, int validH, uint16_t* block) {
+	int r0 = 0, r1 = 255;
+	for (int y = 0; y < validH; y++) {
+		for (int x = 0; x < validW; x++) {
+			int value = to8(tile[y * 4 + x]);
+			r0 = std::max(r0, value);
+			r1 = std::min(r1, value);
+		}
+	}
+
+	uint64_t indices = 0;
+	if (r0 > r1) {
+		for (int y = 0; y < validH; y++) {
+			for (int x = 0; x < validW; x++) {
+				int value = to8(tile[y * 4 + x]);
+				int best = 0, bestError = INT_MAX;
+				for (int p = 0; p < 8; p++) {
+					int error = abs(value - getBc4Value(r0, r1, p));
+					if (error < bestError) {
+						best = p;
+						bestError = error;
+					}
+				}
+				indices |= (uint64_t)best << (3 * (y * 4 + x));
+			}
+		}
+	}
+	else r1 = r0;
+	block[0] = r0 | (r1 << 8);
+	block[1] = indices & 0xffff;
+	block[2] = (indices >> 16) & 0xffff;
+	block[3] = (indices >> 32) & 0xffff;
+}
+
+void TextureMap::compress() {
+	// encode from the uncompressed levels, laid out again for blocks
+	vector<Level> tiles = levels;
+	vector<uint16_t> tileStorage;
+	tileStorage.swap(storage);
+	int tileValues = getTileValues();
+
+	bCompressed = true;
+	numValues = setupLevels(tiles[0].width, tiles[0].height, nullptr);
+	storage.assign(numValues, 0);
+	setupLevels(tiles[0].width, tiles[0].height, storage.data());
+
+	for (int l = 0; l < levels.size(); l++) {
+		const Level& src = tiles[l];
+		int tilesY = (src.height + tileSize - 1) / tileSize;
+		for (int ty = 0; ty < tilesY; ty++) {
+			for (int tx = 0; tx < src.tilesX; tx++) {
+				size_t tile = (size_t)ty * src.tilesX + tx;
+				int validW = std::min(tileSize, src.width - tx * tileSize);
+				int validH = std::min(tileSize, src.height - ty * tileSize);
+				uint16_t* block = levels[l].texels + tile * blockValues;
+				if (format == Color) encodeBc1(src.texels + tile * tileValues, validW, validH, block);
+				else encodeBc4(src.texels + tile * tileValues, validW, validH, block);
+			}
+		}
+	}
+}
+
+void TextureMap::decodeTexel(const uint16_t* block, int texel, uint16_t* out) const {
+	if (format == Color) {
+		int palette[4][3];
+		getBc1Palette(block[0], block[1], palette);
+		uint32_t indices = block[2] | ((uint32_t)block[3] << 16);
+		const int* c = palette[(indices >> (2 * texel)) & 3];
+		out[0] = c[0] * 257;
+		out[1] = c[1] * 257;
+		out[2] = c[2] * 257;
+		out[3] = 65535;
+	}
+	else {
+		uint64_t indices = block[1] | ((uint64_t)block[2] << 16) | ((uint64_t)block[3] << 32);
+		out[0] = getBc4Value(block[0] & 0xff, block[0] >> 8, (indices >> (3 * texel)) & 7) * 257;
+	}
+}
+
+bool TextureMap::write(std::ostream& out) const {
+	if (levels.empty()) return false;
+	MapRecord record = { (uint32_t)format, (uint32_t)bCompressed, getWidth(), getHeight(), (uint32_t)numValues };
+	out.write((const char*)&record, sizeof(record));
+	out.write((const char*)levels[0].texels, numValues * sizeof(uint16_t));
+	return bool(out);
+}
+
+bool TextureMap::setup(const std::shared_ptr<const MappedFile>& mapped, size_t& offset) {
+	levels.clear();
+	storage.clear();
+	file.reset();
+
+	if (offset + sizeof(MapRecord) > mapped->size()) return false;
+	MapRecord record;
+	memcpy(&record, mapped->data() + offset, sizeof(record));
+	if (record.format > Specular || record.compressed > 1 || record.width <= 0 || record.height <= 0) return false;
+
+	format = (Format)record.format;
+	channels = (format == Color) ? 4 : 1;
+	bCompressed = record.compressed != 0;
+	numValues = setupLevels(record.width, record.height, nullptr);
+	size_t bytes = numValues * sizeof(uint16_t);
+	if (numValues != record.numValues || offset + sizeof(MapRecord) + bytes > mapped->size()) {
+		levels.clear();
+		return false;
+	}
+
+	// the texels are only ever read, the pointer just isn't const for setup()
+	uint16_t* texels = (uint16_t*)(mapped->data() + offset + sizeof(MapRecord));
+	setupLevels(record.width, record.height, texels);
+	file = mapped;
+	offset += sizeof(MapRecord) + bytes;
+	return true;
+}
+
+void TextureMap::sampleLevel(int l, float u, float v, float* out) const {
+	const Level& level = levels[l];
+
+	// texel centers are at half integers, wrap the neighbors around the edges
+	float x = u * level.width - 0.5f;
+	float y = v * level.height - 0.5f;
+	float fx = floor(x), fy = floor(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = (int)fx % level.width, y0 = (int)fy % level.height;
+	if (x0 < 0) x0 += level.width;
+	if (y0 < 0) y0 += level.height;
+	int x1 = (x0 + 1 == level.width) ? 0 : x0 + 1;
+	int y1 = (y0 + 1 == level.height) ? 0 : y0 + 1;
+
+	uint16_t decoded[4][4];
+	const uint16_t* a = getTexel(level, x0, y0, decoded[0]);
+	const uint16_t* b = getTexel(level, x1, y0, decoded[1]);
+	const uint16_t* c = getTexel(level, x0, y1, decoded[2]);
+	const uint16_t* d = getTexel(level, x1, y1, decoded[3]);
+	for (int k = 0; k < std::min(channels, 3); k++) {
+		float top = a[k] + (b[k] - a[k]) * tx;
+		float bottom = c[k] + (d[k] - c[k]) * tx;
+		out[k] = (top + (bottom - top) * ty) * (1.0f / 257);
+	}
+}
+
+void TextureMap::sample(float u, float v, float footprint, float* out) const {
+	// level whose texels are the size of the footprint
+	float lod = (footprint > 0) ? log2(footprint * std::max(getWidth(), getHeight())) : 0;
+	int last = getNumLevels() - 1;
+	if (lod <= 0) {
+		sampleLevel(0, u, v, out);
+		return;
+	}
+	if (lod >= last) {
+		sampleLevel(last, u, v, out);
+		return;
+	}
+
+	int l = (int)lod;
+	float t = lod - l;
+	float fine[3], coarse[3];
+	sampleLevel(l, u, v, fine);
+	sampleLevel(l + 1, u, v, coarse);
+	for (int k = 0; k < std::min(channels, 3); k++) out[k] = fine[k] + (coarse[k] - fine[k]) * t;
+}
+
+ofColor TextureMap::getColor(float u, float v, float footprint) const {
+	float c[3];
+	sample(u, v, footprint, c);
+	return ofColor(c[0] + 0.5f, c[1] + 0.5f, c[2] + 0.5f);
+}
+
+float TextureMap::getValue(float u, float v, float footprint) const {
+	float c[3];
+	sample(u, v, footprint, c);
+	return c[0];
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ofMain.h"
+#include "MappedFile.h"
+#include <memory>
+
+
+//  Texture map in the layout the renderer samples: 16 bits per channel, in
+//  4x4 texel tiles so the four texels of a bilinear lookup are nearly always
+//  in the same 128 bytes, with the full chain of mip levels.  Color maps keep
+//  rgb (padded to 4 channels), specular maps only the brightness of the
+//  image, which is what shading uses as the phong power.
+//
+//  Compressed maps store every tile as one 8 byte block instead, BC1 for
+//  color maps and BC4 for specular maps (the same blocks GPUs use), and
+//  decode texels from it as they are sampled.  That is 16x less memory for
+//  color maps and 4x less for specular maps, for a little loss of color.
+class TextureMap {
+public:
+	enum Format { Color, Specular };
+
+	TextureMap() {}
+	TextureMap(const TextureMap&) = delete;		// levels point into the map's own storage
+	TextureMap& operator=(const TextureMap&) = delete;
+
+	// build every level from an 8 bit image
+	void setup(const ofPixels& pixels, Format format, bool bCompressed = false);
+
+	// write the map as a record of a cache file
+	bool write(std::ostream& out) const;
+	// use the record at offset in a mapped cache file in place, without copying
+	// it.  offset is moved past the record, false if it isn't a valid one.
+	bool setup(const std::shared_ptr<const MappedFile>& file, size_t& offset);
+
+	bool isAllocated() const { return !levels.empty(); }
+	bool isMapped() const { return file != nullptr; }
+	bool isCompressed() const { return bCompressed; }
+	Format getFormat() const { return format; }
+	int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+	int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+	int getNumLevels() const { return (int)levels.size(); }
+
+	// filtered lookup at (u, v), wrapping around the edges.  footprint is the
+	// size of the shaded area in uv units: magnified lookups are bilinear,
+	// minified ones trilinear between the two closest levels.  Channels are
+	// in [0, 255], specular maps only write out[0].
+	void sample(float u, float v, float footprint, float* out) const;
+	ofColor getColor(float u, float v, float footprint) const;
+	float getValue(float u, float v, float footprint) const;
+
+	// bilinear lookup in one level
+	void sampleLevel(int level, float u, float v, float* out) const;
+
+private:
+	struct Level {
+		int width = 0, height = 0;
+		int tilesX = 0;
+		uint16_t* texels = nullptr;	// tile by tile, rows of 4 texels within a tile (read-only if mapped)
+	};
+	static constexpr int tileSize = 4;
+	static constexpr int blockValues = 4;	// values of a compressed tile
+
+	int getTileValues() const { return bCompressed ? blockValues : tileSize * tileSize * channels; }
+
+	// texel (x, y) of a level as 16 bit values: in place, or decoded into
+	// decoded (room for 4 values) if the map is compressed
+	const uint16_t* getTexel(const Level& level, int x, int y, uint16_t* decoded) const {
+		size_t tile = (size_t)(y / tileSize) * level.tilesX + x / tileSize;
+		int texel = (y % tileSize) * tileSize + x % tileSize;
+		if (bCompressed) {
+			decodeTexel(level.texels + tile * blockValues, texel, decoded);
+			return decoded;
+		}
+		return level.texels + (tile * tileSize * tileSize + texel) * channels;
+	}
+	uint16_t* getTexel(Level& level, int x, int y) {
+		return const_cast<uint16_t*>(getTexel(const_cast<const Level&>(level), x, y, nullptr));
+	}
+	void decodeTexel(const uint16_t* block, int texel, uint16_t* out) const;
+	// replace the tiles of every level with compressed blocks
+	void compress();
+	// lay out the levels of a width x height map over texels, returns the
+	// number of values they take up (texels can be null to just count)
+	size_t setupLevels(int width, int height, uint16_t* texels);
+
+	Format format = Color;
+	int channels = 4;
+	bool bCompressed = false;
+	vector<Level> levels;
+	size_t numValues = 0;						// 16 bit values of all levels
+	vector<uint16_t> storage;					// texels of every level, unless mapped
+	std::shared_ptr<const MappedFile> file;		// cache file the texels are in, if mapped
+};
@@ -0,0 +1,147 @@
+#include "ThreadPool.h"
+
+
+// which pool (if any) the current thread works for, and its index in that pool
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local int currentIndex = -1;
+
+void ThreadPool::resize(int numThreads) {
+	shutdown();
+
+	if (numThreads <= 0) numThreads = std::thread::hardware_concurrency();
+	if (numThreads <= 0) numThreads = 1;
+
+	queues.clear();
+	for (int i = 0; i <= numThreads; i++) {
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+
+	bStop = false;
+	for (int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+void ThreadPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		bStop = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers) worker.join();
+	workers.clear();
+
+	// drop the submitted tasks nobody got to
+	for (auto& queue : queues) {
+		for (auto& task : queue->tasks) {
+			if (!task.pending) delete task.fn;
+		}
+		queue->tasks.clear();
+	}
+	queuedTasks = 0;
+}
+
+int ThreadPool::threadIndex() const {
+	return (currentPool == this) ? currentIndex : size();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& fn) {
+	if (count <= 0) return;
+
+	std::atomic<int> pending(count);
+	int self = threadIndex();
+
+	// a worker keeps nested work in its own queue (others will steal it),
+	// outside callers spread the batch over all workers so they start at once
+	if (self < size()) {
+		WorkQueue& queue = *queues[self];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (int i = 0; i < count; i++) queue.tasks.push_back(Task{ &fn, i, &pending });
+	}
+	else {
+		for (int i = 0; i < count; i++) {
+			WorkQueue& queue = *queues[i % size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(Task{ &fn, i, &pending });
+		}
+	}
+	queuedTasks += count;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+
+	// help out until the whole batch is finished
+	while (pending > 0) {
+		Task task;
+		if (popTask(self, task) || stealTask(self, task)) runTask(task);
+		else std::this_thread::yield();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> fn) {
+	// queued on the outside callers' queue, any idle worker steals it from there
+	auto task = new std::function<void(int)>([fn = std::move(fn)](int) { fn(); });
+	{
+		WorkQueue& queue = *queues[size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(Task{ task, 0, nullptr });
+	}
+	queuedTasks++;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::workerLoop(int id) {
+	currentPool = this;
+	currentIndex = id;
+
+	while (!bStop) {
+		Task task;
+		if (popTask(id, task) || stealTask(id, task)) {
+			runTask(task);
+			continue;
+		}
+
+		// nothing to do, sleep until new tasks are queued
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return bStop || queuedTasks > 0; });
+	}
+}
+
+// take the most recently queued task from our own queue
+bool ThreadPool::popTask(int id, Task& task) {
+	WorkQueue& queue = *queues[id];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty()) return false;
+
+	task = queue.tasks.back();
+	queue.tasks.pop_back();
+	queuedTasks--;
+	return true;
+}
+
+// take the oldest task from another thread's queue
+bool ThreadPool::stealTask(int id, Task& task) {
+	int n = (int)queues.size();
+	for (int i = 1; i < n; i++) {
+		WorkQueue& queue = *queues[(id + i) % n];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) continue;
+
+		task = queue.tasks.front();
+		queue.tasks.pop_front();
+		queuedTasks--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::runTask(Task& task) {
+	(*task.fn)(task.index);
+	if (task.pending) (*task.pending)--;
+	else delete task.fn;
+}
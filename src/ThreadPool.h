@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//  Work-stealing thread pool used for rendering.
+//  Every worker owns a queue of tasks: it takes work from the back of its own
+//  queue and, once that runs dry, steals from the front of another worker's
+//  queue, so expensive tasks never leave the other cores idle.
+//  The thread calling parallelFor() helps run tasks until its batch is done,
+//  which also makes nested parallelFor() calls safe.
+class ThreadPool {
+public:
+	ThreadPool(int numThreads = 0) { resize(numThreads); }
+	~ThreadPool() { shutdown(); }
+
+	// restart the pool with numThreads workers (0 = one per hardware thread)
+	void resize(int numThreads);
+	int size() const { return (int)workers.size(); }
+
+	// run fn(i) for every i in [0, count) and wait for all of them to finish
+	void parallelFor(int count, const std::function<void(int)>& fn);
+
+	// run fn on one of the workers some time later, without waiting for it.
+	// Tasks still queued when the pool is resized or destroyed never run.  Meant
+	// for pools of their own: parallelFor() on the same pool may help run them.
+	void submit(std::function<void()> fn);
+
+	// index of the calling thread in [0, size()]: workers are 0 .. size() - 1,
+	// any other thread (the app thread) is size().  Useful for per-thread scratch data.
+	int threadIndex() const;
+
+private:
+	struct Task {
+		const std::function<void(int)>* fn;
+		int index;
+		std::atomic<int>* pending;		// null for submitted tasks, which own fn
+	};
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void workerLoop(int id);
+	bool popTask(int id, Task& task);
+	bool stealTask(int id, Task& task);
+	void runTask(Task& task);
+	void shutdown();
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkQueue>> queues;	// one per worker + one for outside callers
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queuedTasks{ 0 };
+	std::atomic<bool> bStop{ false };
+};
@@ -1,5 +1,19 @@
 #include "ofApp.h"
 
+// texture sets the gui can apply, maps are relative to bin/data
+struct TextureSet {
+	const char* name;
+	const char* diffuse;
+	const char* specular;
+};
+static const TextureSet textureSets[] = {
+	{ "Garage Paving", "garage-paving/11_garage paving PBR texture_DIFF.jpg", "garage-paving/11_garage paving PBR texture_SPEC.jpg" },
+	{ "Brick Wall", "brick-wall/38_brick wall_DIFF.jpg", "brick-wall/38_brick wall_SPEC.jpg" },
+	{ "Cobblestone Pavement", "cobblestone-pavement/13_cobblestone pavement PBR texture_DIFFUSE.jpg",
+		"cobblestone-pavement/13_cobblestone pavement PBR texture_SPEC.jpg" },
+	{ "Marble Floor", "marble-floor/44_marble floor_DIFF.jpg", "marble-floor/44_marble floor_SPEC.jpg" },
+};
+
 void ofApp::setup() {
 	printf("Setup\n");
 	ofSetBackgroundColor(ofColor::gray);
@@ -38,15 +52,9 @@ void ofApp::setup() {
 	// allocate space for rendered image
 	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
 
-	// load texture maps
-	garageDiffuse.load("garage-paving/11_garage paving PBR texture_DIFF.jpg");
-	garageSpecular.load("garage-paving/11_garage paving PBR texture_SPEC.jpg");
-	brickDiffuse.load("brick-wall/38_brick wall_DIFF.jpg");
-	brickSpecular.load("brick-wall/38_brick wall_SPEC.jpg");
-	cobbleDiffuse.load("cobblestone-pavement/13_cobblestone pavement PBR texture_DIFFUSE.jpg");
-	cobbleSpecular.load("cobblestone-pavement/13_cobblestone pavement PBR texture_SPEC.jpg");
-	marbleDiffuse.load("marble-floor/44_marble floor_DIFF.jpg");
-	marbleSpecular.load("marble-floor/44_marble floor_SPEC.jpg");
+	// texture sets are only loaded once they are applied, see getTextureMaps()
+	setDiffuseMaps.resize(sizeof(textureSets) / sizeof(textureSets[0]));
+	setSpecularMaps.resize(setDiffuseMaps.size());
 
 
 	// create scene objects (for testing) - remove later
@@ -120,6 +128,9 @@ void ofApp::update() {
 		cobblestonePavement = false;
 		marbleFloor = false;
 	}
+
+	// pick up finished passes and edits made this frame
+	pollRender();
 }
 
 void ofApp::draw() {
@@ -158,7 +169,16 @@ void ofApp::draw() {
 
 	// rendered image
 	if (bRendered) {
-		image.draw((ofGetWindowWidth() / 2) - (imageWidth / 2), (ofGetWindowHeight() / 2) - (imageHeight / 2), imageWidth, imageHeight);
+		float x = (ofGetWindowWidth() / 2) - (imageWidth / 2);
+		float y = (ofGetWindowHeight() / 2) - (imageHeight / 2);
+		image.draw(x, y, imageWidth, imageHeight);
+
+		// cost of every tile on top, tiles past the edge of the image are cut off
+		if (showHeatmap && heatmap.isAllocated()) {
+			ofSetColor(ofColor::white);
+			float tileSize = tileCosts.tileSize;
+			heatmap.drawSubsection(x, y, imageWidth, imageHeight, 0, 0, tileCosts.width / tileSize, tileCosts.height / tileSize);
+		}
 	}
 
 	if (!bHide) {
@@ -175,9 +195,10 @@ void ofApp::draw() {
 // apply relevant textures to selected object & turn off other texture buttons
 void ofApp::applyNoTexture(bool& val) {
 	if (objSelected() && noTexture) {
+		renderer.cancel(); // the renderer reads the maps in place, stop it before they change
 		selected[0]->textureName = "None";
-		selected[0]->diffuseMap.clear();
-		selected[0]->specularMap.clear();
+		selected[0]->diffuseMap.reset();
+		selected[0]->specularMap.reset();
 
 		brickWall = false;
 		garagePaving = false;
@@ -187,9 +208,9 @@ void ofApp::applyNoTexture(bool& val) {
 }
 void ofApp::applyBrickWall(bool& val) {
 	if (objSelected() && brickWall) {
+		renderer.cancel(); // the renderer reads the maps in place, stop it before they change
 		selected[0]->textureName = "Brick Wall";
-		selected[0]->diffuseMap = brickDiffuse;
-		selected[0]->specularMap = brickSpecular;
+		getTextureMaps("Brick Wall", selected[0]->diffuseMap, selected[0]->specularMap);
 
 		noTexture = false;
 		garagePaving = false;
@@ -199,9 +220,9 @@ void ofApp::applyBrickWall(bool& val) {
 }
 void ofApp::applyCobblestone(bool& val) {
 	if (objSelected() && cobblestonePavement) {
+		renderer.cancel(); // the renderer reads the maps in place, stop it before they change
 		selected[0]->textureName = "Cobblestone Pavement";
-		selected[0]->diffuseMap = cobbleDiffuse;
-		selected[0]->specularMap = cobbleSpecular;
+		getTextureMaps("Cobblestone Pavement", selected[0]->diffuseMap, selected[0]->specularMap);
 
 		noTexture = false;
 		garagePaving = false;
@@ -211,9 +232,9 @@ void ofApp::applyCobblestone(bool& val) {
 }
 void ofApp::applyGaragePaving(bool& val) {
 	if (objSelected() && garagePaving) {
+		renderer.cancel(); // the renderer reads the maps in place, stop it before they change
 		selected[0]->textureName = "Garage Paving";
-		selected[0]->diffuseMap = garageDiffuse;
-		selected[0]->specularMap = garageSpecular;
+		getTextureMaps("Garage Paving", selected[0]->diffuseMap, selected[0]->specularMap);
 
 		noTexture = false;
 		brickWall = false;
@@ -223,9 +244,9 @@ void ofApp::applyGaragePaving(bool& val) {
 }
 void ofApp::applyMarbleFloor(bool& val) {
 	if (objSelected() && marbleFloor) {
+		renderer.cancel(); // the renderer reads the maps in place, stop it before they change
 		selected[0]->textureName = "Marble Floor";
-		selected[0]->diffuseMap = marbleDiffuse;
-		selected[0]->specularMap = marbleSpecular;
+		getTextureMaps("Marble Floor", selected[0]->diffuseMap, selected[0]->specularMap);
 
 		noTexture = false;
 		garagePaving = false;
@@ -248,6 +269,10 @@ void ofApp::keyPressed(int key) {
 		// show/hide rendered image
 		bRendered = !bRendered;
 		break;
+	case 'm':
+		// show/hide render cost heatmap
+		showHeatmap = !showHeatmap;
+		break;
 	case 'r': // render image with raytracing
 		rayTrace();
 		break;
@@ -431,186 +456,382 @@ void ofApp::addAreaLight() {
 
 int ofApp::ext = 0;
 
-// main ray trace loop, called by 'r' button
+// main ray trace loop, called by 'r' button.
+// The render runs in the background, pollRender() shows its passes as they finish.
 void ofApp::rayTrace() {
 	printf("rayTrace called\n");
+	renderer.start(getRenderScene());
+	bRenderActive = true;
+}
+
+// copy everything the renderer needs out of the scene, lights, render cam and gui.
+// sources gets the scene object of each render object.
+RenderScene ofApp::getRenderScene(vector<SceneObject*>* sources) {
+	RenderScene render;
+
+	for (auto obj : scene) {
+		RenderObject ro;
+		Sphere* sphere = dynamic_cast<Sphere*>(obj);
+		Plane* plane = dynamic_cast<Plane*>(obj);
+
+		if (sphere) {
+			ro.type = RenderObject::Sphere;
+			ro.radius = sphere->radius;
+		}
+		else if (plane && plane->getBounds(ro.extent)) {
+			ro.type = RenderObject::Plane;
+			ro.normal = plane->normal;
+			ro.upDir = plane->plane.getUpDir();
+			ro.width = plane->width;
+			ro.height = plane->height;
+		}
+		else continue; // planes with other normals are never hit
+
+		ro.position = obj->position;
+		ro.diffuseColor = obj->diffuseColor;
+		ro.numTiles = obj->numTiles;
+		if (obj->diffuseMap && obj->specularMap) {
+			ro.diffuseMap = &obj->diffuseMap->getMap(TextureMap::Color);
+			ro.specularMap = &obj->specularMap->getMap(TextureMap::Specular);
+		}
+		render.objects.push_back(ro);
+		if (sources) sources->push_back(obj);
+	}
+
+	for (auto light : lights) {
+		RenderLight rl;
+		AreaLight* area = dynamic_cast<AreaLight*>(light);
+
+		if (area) {
+			rl.type = RenderLight::Area;
+			rl.position = area->position;
+			rl.width = area->width;
+			rl.height = area->height;
+			rl.nDivsWidth = area->nDivsWidth;
+			rl.nDivsHeight = area->nDivsHeight;
+			rl.nSamples = area->nSamples;
+		}
+		else if (dynamic_cast<PointLight*>(light)) {
+			rl.type = RenderLight::Point;
+			rl.position = light->position;
+		}
+		else continue;
+
+		rl.intensity = light->intensity;
+		render.lights.push_back(rl);
+	}
 
 	// offsets for getting ray
 	float w = (ofGetWindowWidth() - imageWidth) / 2;
 	float h = (ofGetWindowHeight() - imageHeight) / 2;
 
-	// go through each pixel in image
-	for (int i = 0; i < imageWidth; i++) {
-		for (int j = 0; j < imageHeight; j++) {
-
-			float u = (i + 0.5) / imageWidth;
-			float v = (j + 0.5) / imageHeight;
-
-			// render through the preview cam
-			glm::vec3 tmp = renderCam.screenToWorld(glm::vec3((u * imageWidth) + w, (v * imageHeight) + h, 0));
-			Ray ray = Ray(renderCam.getPosition(), glm::normalize(tmp - renderCam.getPosition()));
-
-			// variables to store information from intersection check
-			float distance = std::numeric_limits<float>::infinity();
-			glm::vec3 closestPoint;
-			glm::vec3 normalAtIntersect;
-			SceneObject* closestObject = NULL;
-
-			// check all objects in scene for intersection
-			for (SceneObject* object : scene) {
-				glm::vec3 point;
-				glm::vec3 normal;
-
-				// check intersection distance from camera
-				if (object->intersect(ray, point, normal)) {
-					float intersectDistance = glm::distance(ray.p, point);
-					if (intersectDistance < distance) {
-						closestObject = object;
-						closestPoint = point;
-						normalAtIntersect = normal;
-						distance = intersectDistance;
-					}
-				}
-			}
+	// screen -> world is affine on the near plane, so the view only needs
+	// one corner and the two edges to generate every primary ray.
+	// screenToWorld() depends on the current window, so this has to run on the app thread.
+	render.view.origin = renderCam.getPosition();
+	render.view.corner = renderCam.screenToWorld(glm::vec3(w, h, 0));
+	render.view.right = renderCam.screenToWorld(glm::vec3(imageWidth + w, h, 0)) - render.view.corner;
+	render.view.down = renderCam.screenToWorld(glm::vec3(w, imageHeight + h, 0)) - render.view.corner;
+
+	RenderSettings& settings = render.settings;
+	settings.width = imageWidth;
+	settings.height = imageHeight;
+	settings.threads = renderThreads;
+	settings.lambert = lambertShading;
+	settings.phong = phongShading;
+	settings.phongPower = phongPower;
+	settings.ambientIntensity = ambientLight.intensity;
+	settings.background = ofGetBackgroundColor();
+	settings.packetTracing = packetTracing;
+	settings.progressive = progressiveRender;
+	settings.passes = progressivePasses;
+	settings.adaptiveShadows = adaptiveShadows;
+	settings.shadowTolerance = shadowTolerance;
+	settings.shadowRate = shadowRate;
+	settings.sampler = (Sampler::Type)sampler.get();
+	settings.seed = samplerSeed;
+	settings.adaptiveAA = adaptiveAA;
+	settings.aaThreshold = aaThreshold;
+	settings.aaMaxSamples = aaMaxSamples;
+	settings.denoise = denoise;
+	settings.denoiseIterations = denoiseIterations;
+
+	return render;
+}
 
-			if (closestObject) {
-				// default values if object has no texture/shading type not selected
-				ofColor color = closestObject->diffuseColor;
-				float specular = phongPower;
-
-				// check for textures closestObject->textureName != "None"
-				if (closestObject->diffuseMap.isAllocated() && closestObject->specularMap.isAllocated()) {
-					
-					// check object type (only plane/sphere)
-					Plane* plane = dynamic_cast<Plane*>(closestObject);
-					Sphere* sphere = dynamic_cast<Sphere*>(closestObject);
-
-					// texture coordinates depend on object type
-					float texU, texV;
-					if (plane) {
-						plane->getTextureCoords(closestPoint, texU, texV);
-					}
-					else if (sphere) {
-						sphere->getTextureCoords(closestPoint, texU, texV);
-					}
-
-					// get texture color from diffuse map
-					float diffuseX = texU * closestObject->diffuseMap.getWidth();
-					float diffuseY = texV * closestObject->diffuseMap.getHeight();
-					diffuseX = ofClamp(diffuseX, 0, closestObject->diffuseMap.getWidth() - 1);
-					diffuseY = ofClamp(diffuseY, 0, closestObject->diffuseMap.getHeight() - 1);
-					color = closestObject->diffuseMap.getColor(diffuseX, diffuseY);
-
-					// get specular coefficient from specular map
-					int specX = texU * closestObject->specularMap.getWidth();
-					int specY = texV * closestObject->specularMap.getHeight();
-					specX = ofClamp(specX, 0, closestObject->specularMap.getWidth() - 1);
-					specY = ofClamp(specY, 0, closestObject->specularMap.getHeight() - 1);
-					specular = closestObject->specularMap.getColor(specX, specY).getBrightness();
-				}
-
-				if (lambertShading) color = lambert(closestPoint, normalAtIntersect, color);
-				if (phongShading) color = phong(closestPoint, normalAtIntersect, color, ofColor::lightYellow, specular);
-				image.setColor(i, j, color);
-				//image.setColor(i, imageHeight - j - 1, color); // mirror when using renderCam to render
-			}
-			else {
-				// default to background color if no object
-				image.setColor(i, j, ofGetBackgroundColor());
-				//image.setColor(i, imageHeight - j - 1, ofGetBackgroundColor());
+// show the passes of the background render as they finish, and restart it
+// if anything in the scene, camera or settings changed since it started
+void ofApp::pollRender() {
+	bool bFinal;
+	if (renderer.getImage(renderPixels, bFinal)) {
+		image.setFromPixels(renderPixels);
+		bRendered = true;
+		renderStats = renderer.getStats();
+		renderer.getTileCosts(tileCosts);
+		updateHeatmap();
+		if (bFinal) {
+			saveImage();
+			bRenderActive = false;
+			renderStatus = "Done";
+			printf("rayTrace done\n");
+
+			// outside the stats panel too, it's only there with RT_STATS
+			if (renderer.getScene().settings.denoise) {
+				renderStatus = "Done, denoised in " + ofToString(renderStats.denoiseSeconds, 3) + " s";
+				printf("denoised in %.3f s\n", renderStats.denoiseSeconds);
 			}
 		}
+		updateStatsGUI();
+	}
+	if (!bRenderActive) return;
+
+	// stopped for a texture change, or edited: start over with the new scene
+	RenderScene current = getRenderScene();
+	if ((!renderer.isRunning() && !renderer.isFinished()) || current != renderer.getScene()) {
+		renderer.start(current);
 	}
 
-	// update & save image
-	image.update();
+	string status = ofToString((int)(renderer.getProgress() * 100)) + "%";
+	if (progressiveRender) status += " (pass " + ofToString(renderer.getPass()) + "/" + ofToString(progressivePasses) + ")";
+	renderStatus = status;
+}
+
+void ofApp::saveImage() {
 	//string fileName = "/renderedImages/render" + to_string(ofApp::ext++) + ".png";
-	image.save("/renderedImages/render" + to_string(ofApp::ext++) + ".png");
-	bRendered = true;
+	string name = "/renderedImages/render" + to_string(ofApp::ext++);
+#if RT_STATS
+	uint64_t start = ofGetElapsedTimeMicros();
+#endif
+	image.save(name + ".png");
+
+#if RT_STATS
+	// stats of the render go next to its image
+	renderStats.stageSeconds[RenderStats::ImageSave] += (ofGetElapsedTimeMicros() - start) / 1e6;
+	if (!renderStats.writeJson(ofToDataPath(name + ".json"))) ofLogError("ofApp") << "can't write stats of " << name;
+#endif
+}
 
-	printf("rayTrace done\n");
+void ofApp::updateStatsGUI() {
+#if RT_STATS
+	for (int i = 0; i < RenderStats::NumCounters; i++) statsCounters[i] = ofToString(renderStats.counters[i]);
+	for (int i = 0; i < RenderStats::NumStages; i++) statsStages[i] = ofToString(renderStats.stageSeconds[i], 3);
+	statsRenderTime = ofToString(renderStats.renderSeconds, 3);
+	statsDenoiseTime = ofToString(renderStats.denoiseSeconds, 3);
+#endif
 }
 
-// check if any object in the scene intersects the ray between the light and point
-bool ofApp::inShadow(Ray ray) {
-	for (auto obj : scene) {
-		glm::vec3 intersectPoint;
-		glm::vec3 normal;
-		// does not account for objects "above" light
-		if (obj->intersect(ray, intersectPoint, normal)) {
-			return true;
-		}
+
+// ---- render cost heatmap ----
+
+// false color image of the tile costs, one pixel per tile: blue for the
+// cheapest tiles through green and yellow to red for the most expensive
+void ofApp::getHeatmapPixels(ofPixels& pixels, int alpha) {
+	double maxCost = 0;
+	for (auto& tile : tileCosts.tiles) maxCost = std::max(maxCost, heatmapRays ? (double)tile.rays : tile.seconds);
+
+	pixels.allocate(tileCosts.tilesX, tileCosts.tilesY, OF_PIXELS_RGBA);
+	for (int i = 0; i < tileCosts.tiles.size(); i++) {
+		const TileCosts::Tile& tile = tileCosts.tiles[i];
+		double cost = heatmapRays ? (double)tile.rays : tile.seconds;
+		float t = (maxCost > 0) ? cost / maxCost : 0;
+		pixels.setColor(i % tileCosts.tilesX, i / tileCosts.tilesX, ofColor::fromHsb(170 * (1 - t), 255, 255, alpha));
 	}
-	return false;
 }
 
-// lambert shading
-ofColor ofApp::lambert(const glm::vec3& p, const glm::vec3& norm,
-	const ofColor diffuse) {
+void ofApp::updateHeatmap() {
+	if (tileCosts.tiles.empty()) return;
 
-	ofColor result = ambientLight.intensity * diffuse;
-	float totalDiffuse = 0;
-
-	for (auto light : lights) {
-		if (light->intensity <= 0) continue; // skip lights with no "light"
+	ofPixels pixels;
+	getHeatmapPixels(pixels, 160);
+	heatmap.setFromPixels(pixels);
+	heatmap.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+}
 
-		int numRays = light->getRaySamples(p, norm); // get ray(s) from light
-		for (int i = 0; i < numRays; i++) {
-			if (!inShadow(light->samples[i])) {
+// write the tile costs as csv and the heatmap at image size as png, to bin/data
+void ofApp::exportHeatmap() {
+	if (tileCosts.tiles.empty()) return;
+	string name = "heatmap-" + ofGetTimestampString();
+
+	ofstream csv(ofToDataPath(name + ".csv"));
+	csv << "tile_x,tile_y,x,y,width,height,ms,rays\n";
+	for (int i = 0; i < tileCosts.tiles.size(); i++) {
+		int tx = i % tileCosts.tilesX, ty = i / tileCosts.tilesX;
+		int x = tx * tileCosts.tileSize, y = ty * tileCosts.tileSize;
+		csv << tx << "," << ty << "," << x << "," << y << ","
+			<< std::min(tileCosts.tileSize, tileCosts.width - x) << "," << std::min(tileCosts.tileSize, tileCosts.height - y) << ","
+			<< tileCosts.tiles[i].seconds * 1000 << "," << tileCosts.tiles[i].rays << "\n";
+	}
+	if (!csv) {
+		ofLogError("ofApp") << "can't write " << name << ".csv";
+		return;
+	}
 
-				// calculate intensity of light with respect to distance
-				float distance = glm::length(light->samplesPos[i] - p);
-				float illumination = light->intensity / (distance * distance);
+	ofPixels pixels;
+	getHeatmapPixels(pixels, 255);
+	pixels.resize(tileCosts.tilesX * tileCosts.tileSize, tileCosts.tilesY * tileCosts.tileSize, OF_INTERPOLATE_NEAREST_NEIGHBOR);
+	pixels.crop(0, 0, tileCosts.width, tileCosts.height);
+	ofSaveImage(pixels, name + ".png");
+	printf("exported %s.csv and %s.png\n", name.c_str(), name.c_str());
+}
 
-				// lambert formula
-				glm::vec3 lightDirection = light->samples[i].d;
-				float lambertCalc = glm::max(glm::dot(norm, lightDirection), 0.0f);
 
-				totalDiffuse += lambertCalc * illumination;
+// handles to the maps of a texture set (null if they couldn't be loaded), false if name isn't one.
+// The set starts loading in the background on first use, objects show a placeholder until then.
+bool ofApp::getTextureMaps(const string& name, TextureHandle& diffuse, TextureHandle& specular) {
+	for (int i = 0; i < setDiffuseMaps.size(); i++) {
+		if (name == textureSets[i].name) {
+			if (!setDiffuseMaps[i] || !setSpecularMaps[i]) {
+				setDiffuseMaps[i] = getTextureCache().get(textureSets[i].diffuse);
+				setSpecularMaps[i] = getTextureCache().get(textureSets[i].specular);
 			}
+			diffuse = setDiffuseMaps[i];
+			specular = setSpecularMaps[i];
+			return true;
 		}
-		result += diffuse * (totalDiffuse / numRays);
 	}
-
-	return result;
+	return false;
 }
 
-// phong shading (lambert + specular)
-ofColor ofApp::phong(const glm::vec3& p, const glm::vec3& norm,
-	const ofColor diffuse, const ofColor specular, float power) {
 
-	ofColor result = ambientLight.intensity * diffuse;
-	float totalDiffuse = 0;
-	float totalSpecular = 0;
+// ---- scene files ----
 
-	for (auto light : lights) {
-		if (light->intensity <= 0) continue; // skip lights with no "light"
+// the scene as saved to a file: what the renderer sees, plus the render cam and texture paths
+SceneDescription ofApp::getSceneDescription() {
+	SceneDescription desc;
+	vector<SceneObject*> sources;
+	RenderScene render = getRenderScene(&sources);
+	desc.scene.lights = render.lights;
+	desc.scene.settings = render.settings;
 
-		int numRays = light->getRaySamples(p, norm); // get ray(s) from light
-		for (int i = 0; i < numRays; i++) {
+	for (int i = 0; i < render.objects.size(); i++) {
+		const SceneObject* obj = sources[i];
+		bool bTextured = obj->diffuseMap && obj->specularMap;
+		desc.addObject(render.objects[i], bTextured ? obj->diffuseMap->path : "", bTextured ? obj->specularMap->path : "");
+	}
 
-			if (!inShadow(light->samples[i])) {
+	// the image only covers the middle of the window, so its fov is narrower than the cam's
+	SceneCamera& camera = desc.camera;
+	camera.position = renderCam.getPosition();
+	camera.target = renderCam.getPosition() + renderCam.getLookAtDir();
+	camera.up = renderCam.getUpDir();
+	float halfHeight = tan(glm::radians(renderCam.getFov()) / 2) * imageHeight / ofGetWindowHeight();
+	camera.fov = glm::degrees(2 * atan(halfHeight));
 
-				// calculate intensity of light with respect to distance
-				float distance = glm::length(light->samplesPos[i] - p);
-				float illumination = light->intensity / (distance * distance);
+	desc.update();
+	return desc;
+}
 
-				// lambert formula
-				glm::vec3 lightDirection = light->samples[i].d;
-				float lambertCalc = glm::max(glm::dot(norm, lightDirection), 0.0f);
+// give an object the maps at the given paths through the texture cache, so maps
+// of the gui's texture sets (or used by other objects) are shared, not loaded again
+void ofApp::setTexture(SceneObject* obj, const string& diffusePath, const string& specularPath) {
+	obj->diffuseMap = getTextureCache().get(diffusePath);
+	obj->specularMap = getTextureCache().get(specularPath);
+	if (!obj->diffuseMap || !obj->specularMap) {
+		obj->diffuseMap.reset();
+		obj->specularMap.reset();
+		return;
+	}
 
-				// specular formula
-				glm::vec3 viewDirection = glm::normalize(renderCam.getPosition() - p);
-				glm::vec3 h = glm::normalize(viewDirection + lightDirection);
-				float specularCalc = glm::pow(glm::max(glm::dot(norm, h), 0.0f), power);
+	// sets may not be loaded yet, so compare paths rather than handles
+	obj->textureName = ofFilePath::getBaseName(diffusePath);
+	for (auto& set : textureSets) {
+		if (obj->diffuseMap->path == TextureCache::getKey(set.diffuse) &&
+			obj->specularMap->path == TextureCache::getKey(set.specular)) obj->textureName = set.name;
+	}
+}
 
-				totalDiffuse += lambertCalc * illumination;
-				totalSpecular += specularCalc * illumination;
-			}
+// replace the scene, lights, render cam and settings with a loaded scene file
+void ofApp::setScene(const SceneDescription& desc) {
+	renderer.cancel();
+	bRenderActive = false;
+	renderStatus = "Idle";
+
+	for (auto obj : selected) obj->bSelected = false;
+	selected.clear();
+
+	// the old objects hold on to their texture handles (and so the maps) until deleted
+	for (auto obj : scene) delete obj;
+	for (auto light : lights) delete light;
+	scene.clear();
+	lights.clear();
+	areaLight = nullptr;
+
+	for (int i = 0; i < desc.scene.objects.size(); i++) {
+		const RenderObject& ro = desc.scene.objects[i];
+		SceneObject* obj;
+		if (ro.type == RenderObject::Sphere) obj = new Sphere(ro.position, ro.radius, ro.diffuseColor);
+		else obj = new Plane(ro.position, ro.normal, ro.diffuseColor, ro.width, ro.height);
+
+		if (desc.diffuseMaps[i] >= 0 && desc.specularMaps[i] >= 0) {
+			setTexture(obj, desc.texturePaths[desc.diffuseMaps[i]], desc.texturePaths[desc.specularMaps[i]]);
 		}
-		result += (diffuse * (totalDiffuse / numRays)) + (specular * (totalSpecular / numRays));
+		obj->numTiles = ro.numTiles;
+		obj->nTiles = ro.numTiles;
+		scene.push_back(obj);
 	}
 
-	return result;
+	for (auto& rl : desc.scene.lights) {
+		if (rl.type == RenderLight::Area) {
+			addLight(new AreaLight(rl.position, rl.intensity, rl.width, rl.height, rl.nDivsWidth, rl.nDivsHeight, rl.nSamples));
+		}
+		else addLight(new PointLight(rl.position, rl.intensity));
+	}
+
+	// settings, the resolution first since the fov depends on it
+	const RenderSettings& settings = desc.scene.settings;
+	imageWidth = settings.width;
+	imageHeight = settings.height;
+	image.allocate(imageWidth, imageHeight, OF_IMAGE_COLOR);
+	res1200x800.setWithoutEventNotifications(imageWidth == 1200 && imageHeight == 800);
+	res600x400.setWithoutEventNotifications(imageWidth == 600 && imageHeight == 400);
+	renderThreads = settings.threads;
+	lambertShading = settings.lambert;
+	phongShading = settings.phong;
+	phongPower = settings.phongPower;
+	ambientLightIntensity = settings.ambientIntensity;
+	ambientLight.intensity = settings.ambientIntensity;
+	packetTracing = settings.packetTracing;
+	progressiveRender = settings.progressive;
+	progressivePasses = settings.passes;
+	adaptiveShadows = settings.adaptiveShadows;
+	shadowTolerance = settings.shadowTolerance;
+	shadowRate = settings.shadowRate;
+	sampler = settings.sampler;
+	samplerSeed = settings.seed;
+	adaptiveAA = settings.adaptiveAA;
+	aaThreshold = settings.aaThreshold;
+	aaMaxSamples = settings.aaMaxSamples;
+	denoise = settings.denoise;
+	denoiseIterations = settings.denoiseIterations;
+	ofSetBackgroundColor(settings.background);
+
+	// inverse of getSceneDescription(): widen the image fov to the window's
+	const SceneCamera& camera = desc.camera;
+	renderCam.setPosition(camera.position);
+	renderCam.lookAt(camera.target, camera.up);
+	float halfHeight = tan(glm::radians(camera.fov) / 2) * ofGetWindowHeight() / imageHeight;
+	renderCam.setFov(glm::degrees(2 * atan(halfHeight)));
 }
 
+// ".sceneb" files are saved in the binary form, anything else as text
+void ofApp::saveSceneFile() {
+	ofFileDialogResult result = ofSystemSaveDialog("scene.scene", "Save Scene");
+	if (!result.bSuccess) return;
+
+	string path = result.getPath();
+	SceneDescription desc = getSceneDescription();
+	bool ok = (ofToLower(ofFilePath::getFileExt(path)) == "sceneb") ? saveSceneBinary(path, desc) : saveSceneText(path, desc);
+	if (ok) printf("saved scene %s\n", path.c_str());
+}
+
+void ofApp::loadSceneFile() {
+	ofFileDialogResult result = ofSystemLoadDialog("Load Scene");
+	if (!result.bSuccess) return;
+
+	// without textures: setScene() fetches the maps through the texture cache (setTexture)
+	SceneDescription desc;
+	if (!loadScene(result.getPath(), desc, false)) return;
+	setScene(desc);
+	printf("loaded scene %s: %d objects, %d lights\n", result.getPath().c_str(),
+		(int)scene.size(), (int)lights.size());
+}
@@ -3,6 +3,8 @@
 #include "ofMain.h"
 #include "ofxGui.h"
 #include "Primitives.h"
+#include "Renderer.h"
+#include "SceneFile.h"
 #include <glm/gtx/intersect.hpp>
 
 
@@ -27,12 +29,28 @@ public:
 		gui.add(createAreaLight.setup("Create New AreaLight"));
 		gui.add(delObject.setup("Delete Selected (DEL)"));
 
+		saveSceneButton.addListener(this, &ofApp::saveSceneFile);
+		loadSceneButton.addListener(this, &ofApp::loadSceneFile);
+		gui.add(saveSceneButton.setup("Save Scene (.sceneb = binary)"));
+		gui.add(loadSceneButton.setup("Load Scene"));
+
 		res1200x800.addListener(this, &ofApp::res12X8);
 		res600x400.addListener(this, &ofApp::res6X4);
 
 		imageSettings.setName("Render Image Resolution");
 		imageSettings.add(res1200x800.set("1200 x 800", true));
 		imageSettings.add(res600x400.set("600 x 400", false));
+		imageSettings.add(renderThreads.set("Render Threads (0 = All Cores)", 0, 0, 64));
+		imageSettings.add(packetTracing.set("Packet Primary Rays (8x8)", false));
+		imageSettings.add(progressiveRender.set("Progressive Render", false));
+		imageSettings.add(progressivePasses.set("Progressive Passes", 64, 1, 1024));
+		imageSettings.add(sampler.set("Sampler (Rand/Halton/Sobol/Blue)", Sampler::Sobol, 0, Sampler::NumTypes - 1));
+		imageSettings.add(samplerSeed.set("Sampler Seed", 0, 0, 1000));
+		imageSettings.add(adaptiveAA.set("Adaptive Anti-Aliasing", false));
+		imageSettings.add(aaThreshold.set("AA Threshold", 0.1, 0.01, 0.5));
+		imageSettings.add(aaMaxSamples.set("AA Max Samples", 16, 4, 64));
+		imageSettings.add(denoise.set("Denoise", false));
+		imageSettings.add(denoiseIterations.set("Denoise Iterations", 5, 1, 8));
 
 		gui.add(imageSettings);
 
@@ -44,13 +62,37 @@ public:
 		shading.add(lambertShading.set("Lambert Shading", false));
 		shading.add(phongShading.set("Phong Shading", false));
 		shading.add(phongPower.set("Phong p value", 10, 0, 50));
+		shading.add(adaptiveShadows.set("Adaptive Area Light Shadows", true));
+		shading.add(shadowTolerance.set("Shadow Tolerance", 0.05, 0.01, 0.25));
+		shading.add(shadowRate.set("Shadow Rate (1 = Every Pixel)", 1, 1, 4));
 
 		gui.add(shading);
 
 		renderScene.addListener(this, &ofApp::rayTrace);
 		gui.add(renderScene.setup("Render (R)"));
+		gui.add(renderStatus.setup("Render", "Idle"));
+#if RT_STATS
+		statsGroup.setup("Render Statistics");
+		for (int i = 0; i < RenderStats::NumCounters; i++) {
+			statsGroup.add(statsCounters[i].setup(RenderStats::getCounterName((RenderStats::Counter)i), "0"));
+		}
+		for (int i = 0; i < RenderStats::NumStages; i++) {
+			statsGroup.add(statsStages[i].setup(string(RenderStats::getStageName((RenderStats::Stage)i)) + " (s)", "0"));
+		}
+		statsGroup.add(statsRenderTime.setup("Render Time (s)", "0"));
+		statsGroup.add(statsDenoiseTime.setup("Denoise Time (s)", "0"));
+		gui.add(&statsGroup);
+#endif
 		gui.add(bRendered.set("Show Image (I)", false));
 
+		heatmapRays.addListener(this, &ofApp::heatmapModeChanged);
+		exportHeatmapButton.addListener(this, &ofApp::exportHeatmap);
+		heatmapSettings.setName("Render Cost Heatmap");
+		heatmapSettings.add(showHeatmap.set("Show Heatmap (M)", false));
+		heatmapSettings.add(heatmapRays.set("Rays Per Tile (Else Time)", false));
+		gui.add(heatmapSettings);
+		gui.add(exportHeatmapButton.setup("Export Heatmap"));
+
 		noTexture.addListener(this, &ofApp::applyNoTexture);
 		brickWall.addListener(this, &ofApp::applyBrickWall);
 		cobblestonePavement.addListener(this, &ofApp::applyCobblestone);
@@ -122,12 +164,26 @@ public:
 	void applyCobblestone(bool& val);
 	void applyGaragePaving(bool& val);
 	void applyMarbleFloor(bool& val);
+	bool getTextureMaps(const string& name, TextureHandle& diffuse, TextureHandle& specular);
 
 	void rayTrace();
-	bool inShadow(Ray ray);
-	ofColor lambert(const glm::vec3& p, const glm::vec3& norm, const ofColor diffuse);
-	ofColor phong(const glm::vec3& p, const glm::vec3& norm,
-		const ofColor diffuse, const ofColor specular, float power);
+	RenderScene getRenderScene(vector<SceneObject*>* sources = nullptr);
+	void pollRender();
+	void saveImage();
+	void updateStatsGUI();
+
+	// render cost heatmap
+	void heatmapModeChanged(bool& val) { updateHeatmap(); }
+	void updateHeatmap();
+	void getHeatmapPixels(ofPixels& pixels, int alpha);
+	void exportHeatmap();
+
+	// scene files
+	SceneDescription getSceneDescription();
+	void setScene(const SceneDescription& desc);
+	void setTexture(SceneObject* obj, const string& diffusePath, const string& specularPath);
+	void saveSceneFile();
+	void loadSceneFile();
 	
 	void drawGrid() {}
 
@@ -165,11 +221,19 @@ public:
 	int imageWidth = 1200;
 	int imageHeight = 800;
 
-	// texture maps
-	ofImage garageDiffuse, garageSpecular;
-	ofImage brickDiffuse, brickSpecular;
-	ofImage cobbleDiffuse, cobbleSpecular;
-	ofImage marbleDiffuse, marbleSpecular;
+	// renders a snapshot of the scene in the background, restarted whenever
+	// the scene is edited while a render is active
+	Renderer renderer;
+	ofPixels renderPixels;
+	bool bRenderActive = false;
+	RenderStats renderStats;	// of the last image, written next to it when RT_STATS is on
+	TileCosts tileCosts;		// of the last image
+	ofImage heatmap;			// one pixel per tile
+
+	// maps of the texture sets the gui applies (see textureSets in ofApp.cpp), null until
+	// a set is first applied.  Objects share these handles, holding them keeps the maps
+	// in the texture cache.
+	vector<TextureHandle> setDiffuseMaps, setSpecularMaps;
 	
 	// state
 	bool bDrag;
@@ -180,18 +244,44 @@ public:
 	bool bHide = false;
 	ofxButton updateRender;
 	ofxButton createPlane, createSphere, createPointLight, createAreaLight, delObject;
+	ofxButton saveSceneButton, loadSceneButton;
 
 	// image settings
 	ofParameterGroup imageSettings;
 	ofParameter<bool> res600x400, res1200x800;
+	ofParameter<int> renderThreads;
+	ofParameter<bool> packetTracing;
+	ofParameter<bool> progressiveRender;
+	ofParameter<int> progressivePasses;
+	ofParameter<int> sampler;		// Sampler::Type
+	ofParameter<int> samplerSeed;
+	ofParameter<bool> adaptiveAA;
+	ofParameter<float> aaThreshold;
+	ofParameter<int> aaMaxSamples;
+	ofParameter<bool> denoise;
+	ofParameter<int> denoiseIterations;
 	ofxButton renderScene;
+	ofxLabel renderStatus;
+	ofxGuiGroup statsGroup;
+	ofxLabel statsCounters[RenderStats::NumCounters];
+	ofxLabel statsStages[RenderStats::NumStages];
+	ofxLabel statsRenderTime;
+	ofxLabel statsDenoiseTime;
 	ofParameter<bool> bRendered;
 
+	// render cost heatmap
+	ofParameterGroup heatmapSettings;
+	ofParameter<bool> showHeatmap, heatmapRays;
+	ofxButton exportHeatmapButton;
+
 	// shading options
 	ofParameterGroup shading;
 	ofParameter<float> ambientLightIntensity;
 	ofParameter<bool> lambertShading, phongShading;
 	ofParameter<float> phongPower;
+	ofParameter<bool> adaptiveShadows;
+	ofParameter<float> shadowTolerance;
+	ofParameter<int> shadowRate;
 
 	// texture application
 	ofParameterGroup textures;